@@ -0,0 +1,306 @@
+/*! \file arena.c
+ *  \brief Memory and resources that live as long as a gamestate.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+struct Arena* CreateArena(struct Game* game, const char* name) {
+	struct Arena* arena = calloc(1, sizeof(struct Arena));
+	arena->name = strdup(name);
+	arena->bitmapRefs = CountBitmapReferences(game);
+	arena->sampleInstances = CountSampleInstances(game);
+	return arena;
+}
+
+void* ArenaAlloc(struct Arena* arena, size_t size) {
+	// Zeroed, like calloc. There's no free; it all goes away with the arena.
+	size = (size + 15) & ~(size_t)15;
+	struct ArenaBlock* block = arena->blocks;
+	if (!block || block->size - block->used < size) {
+		size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+		block = calloc(1, sizeof(struct ArenaBlock) + capacity);
+		block->size = capacity;
+		block->next = arena->blocks;
+		arena->blocks = block;
+	}
+	void* ptr = block->data + block->used;
+	block->used += size;
+	arena->allocated += size;
+	return ptr;
+}
+
+void TrackResource(struct Arena* arena, void* slot, void (*release)(struct Game* game, void* slot)) {
+	if (arena->count == arena->capacity) {
+		arena->capacity = arena->capacity ? arena->capacity * 2 : 64;
+		arena->resources = realloc(arena->resources, sizeof(struct TrackedResource) * arena->capacity);
+	}
+	arena->resources[arena->count++] = (struct TrackedResource){.slot = slot, .release = release};
+}
+
+static void TrackMeasuredResource(struct Arena* arena, void* slot, void (*release)(struct Game* game, void* slot), size_t (*measure)(void* slot)) {
+	TrackResource(arena, slot, release);
+	arena->resources[arena->count - 1].measure = measure;
+}
+
+void PublishArena(struct Game* game, struct Arena* arena) {
+	// Main thread only, just like everything else that walks the list.
+	arena->next = game->data->arenas;
+	game->data->arenas = arena;
+}
+
+struct Arena* FindArena(struct Game* game, const char* name) {
+	for (struct Arena* arena = game->data->arenas; arena; arena = arena->next) {
+		if (strcmp(arena->name, name) == 0) {
+			return arena;
+		}
+	}
+	return NULL;
+}
+
+size_t MeasureArena(struct Arena* arena) {
+	// Arena memory plus a rough estimate of the textures and samples it holds. Cached bitmaps
+	// are counted in full even when shared with someone else, so arenas may add up to more
+	// than what's actually resident.
+	size_t size = arena->allocated;
+	for (int i = 0; i < arena->count; i++) {
+		if (arena->resources[i].measure) {
+			size += arena->resources[i].measure(arena->resources[i].slot);
+		}
+	}
+	return size;
+}
+
+void DestroyArena(struct Game* game, struct Arena* arena) {
+	// not published if the gamestate never got to Gamestate_PostLoad
+	for (struct Arena** a = &game->data->arenas; *a; a = &(*a)->next) {
+		if (*a == arena) {
+			*a = arena->next;
+			break;
+		}
+	}
+
+	// The resources may well live in arena memory, so they're released before the blocks are freed.
+	for (int i = arena->count - 1; i >= 0; i--) {
+		arena->resources[i].release(game, arena->resources[i].slot);
+	}
+
+	if (game->config.debug) {
+		int blocks = 0;
+		for (struct ArenaBlock* block = arena->blocks; block; block = block->next) {
+			blocks++;
+		}
+		PrintConsole(game, "Arena %s: %zu bytes in %d block(s), %d resource(s) released.", arena->name, arena->allocated, blocks, arena->count);
+		int bitmaps = CountBitmapReferences(game) - arena->bitmapRefs;
+		int samples = CountSampleInstances(game) - arena->sampleInstances;
+		if (bitmaps > 0 || samples > 0) {
+			PrintConsole(game, "Arena %s leaked %d bitmap reference(s) and %d sample instance(s)!", arena->name, bitmaps > 0 ? bitmaps : 0, samples > 0 ? samples : 0);
+		}
+	}
+
+	struct ArenaBlock* block = arena->blocks;
+	while (block) {
+		struct ArenaBlock* next = block->next;
+		free(block);
+		block = next;
+	}
+	free(arena->resources);
+	free(arena->name);
+	free(arena);
+}
+
+// Measurers and releasers take the address of the field holding the object; empty fields are skipped.
+
+static size_t MeasureBitmap(ALLEGRO_BITMAP* bitmap) {
+	// sub-bitmaps share their parent's pixels
+	if (!bitmap || al_is_sub_bitmap(bitmap)) {
+		return 0;
+	}
+	return (size_t)al_get_bitmap_width(bitmap) * al_get_bitmap_height(bitmap) * 4;
+}
+
+static size_t MeasureTrackedBitmap(void* slot) {
+	return MeasureBitmap(*(ALLEGRO_BITMAP**)slot);
+}
+
+static size_t MeasureTrackedCharacter(void* slot) {
+	// Frames are sub-bitmaps of cached images or atlas pages, so this counts the area they cover.
+	struct Character* character = *(struct Character**)slot;
+	size_t size = 0;
+	if (!character) {
+		return 0;
+	}
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		for (int i = 0; i < s->frameCount; i++) {
+			if (s->frames[i].bitmap) {
+				size += (size_t)al_get_bitmap_width(s->frames[i].bitmap) * al_get_bitmap_height(s->frames[i].bitmap) * 4;
+			}
+		}
+	}
+	return size;
+}
+
+static size_t MeasureTrackedSampleInstance(void* slot) {
+	ALLEGRO_SAMPLE_INSTANCE* instance = *(ALLEGRO_SAMPLE_INSTANCE**)slot;
+	ALLEGRO_SAMPLE* sample = instance ? al_get_sample(instance) : NULL; // still NULL while decoding
+	if (!sample) {
+		return 0;
+	}
+	return (size_t)al_get_sample_length(sample) * al_get_channel_count(al_get_sample_channels(sample)) * al_get_audio_depth_size(al_get_sample_depth(sample));
+}
+
+static void ReleaseTrackedBitmap(struct Game* game, void* slot) {
+	ALLEGRO_BITMAP** bitmap = slot;
+	if (*bitmap) {
+		al_destroy_bitmap(*bitmap);
+		*bitmap = NULL;
+	}
+}
+
+static void ReleaseTrackedCachedBitmap(struct Game* game, void* slot) {
+	ALLEGRO_BITMAP** bitmap = slot;
+	if (*bitmap) {
+		ReleaseBitmap(game, *bitmap);
+		*bitmap = NULL;
+	}
+}
+
+static void ReleaseTrackedCharacter(struct Game* game, void* slot) {
+	struct Character** character = slot;
+	if (*character) {
+		ReleaseCharacter(game, *character);
+		*character = NULL;
+	}
+}
+
+static void ReleaseTrackedShader(struct Game* game, void* slot) {
+	ALLEGRO_SHADER** shader = slot;
+	if (*shader) {
+		al_destroy_shader(*shader);
+		*shader = NULL;
+	}
+}
+
+static void ReleaseTrackedFont(struct Game* game, void* slot) {
+	ALLEGRO_FONT** font = slot;
+	if (*font) {
+		al_destroy_font(*font);
+		*font = NULL;
+	}
+}
+
+static void ReleaseTrackedAudioStream(struct Game* game, void* slot) {
+	ALLEGRO_AUDIO_STREAM** stream = slot;
+	if (*stream) {
+		al_destroy_audio_stream(*stream);
+		*stream = NULL;
+	}
+}
+
+static void ReleaseTrackedSampleInstance(struct Game* game, void* slot) {
+	ALLEGRO_SAMPLE_INSTANCE** instance = slot;
+	if (*instance) {
+		ReleaseSampleInstance(game, *instance);
+		*instance = NULL;
+	}
+}
+
+static void ReleaseTrackedSoundEffect(struct Game* game, void* slot) {
+	int* effect = slot;
+	UnloadSoundEffect(game, *effect);
+	*effect = -1;
+}
+
+static void ReleaseTrackedTimeline(struct Game* game, void* slot) {
+	struct Timeline** timeline = slot;
+	if (*timeline) {
+		TM_Destroy(*timeline);
+		*timeline = NULL;
+	}
+}
+
+static void ReleaseTrackedTimelineProfiler(struct Game* game, void* slot) {
+	struct TimelineProfiler** profiler = slot;
+	if (*profiler) {
+		DestroyTimelineProfiler(*profiler);
+		*profiler = NULL;
+	}
+}
+
+static void ReleaseTrackedTweenBatch(struct Game* game, void* slot) {
+	struct TweenBatch** batch = slot;
+	if (*batch) {
+		DestroyTweenBatch(*batch);
+		*batch = NULL;
+	}
+}
+
+static void ReleaseTrackedSheetStreamer(struct Game* game, void* slot) {
+	struct SheetStreamer** streamer = slot;
+	DestroySheetStreamer(game, *streamer);
+	*streamer = NULL;
+}
+
+void TrackBitmap(struct Arena* arena, ALLEGRO_BITMAP** slot) {
+	TrackMeasuredResource(arena, slot, ReleaseTrackedBitmap, MeasureTrackedBitmap);
+}
+
+void TrackCachedBitmap(struct Arena* arena, ALLEGRO_BITMAP** slot) {
+	TrackMeasuredResource(arena, slot, ReleaseTrackedCachedBitmap, MeasureTrackedBitmap);
+}
+
+void TrackCharacter(struct Arena* arena, struct Character** slot) {
+	TrackMeasuredResource(arena, slot, ReleaseTrackedCharacter, MeasureTrackedCharacter);
+}
+
+void TrackShader(struct Arena* arena, ALLEGRO_SHADER** slot) {
+	TrackResource(arena, slot, ReleaseTrackedShader);
+}
+
+void TrackFont(struct Arena* arena, ALLEGRO_FONT** slot) {
+	TrackResource(arena, slot, ReleaseTrackedFont);
+}
+
+void TrackAudioStream(struct Arena* arena, ALLEGRO_AUDIO_STREAM** slot) {
+	TrackResource(arena, slot, ReleaseTrackedAudioStream);
+}
+
+void TrackSampleInstance(struct Arena* arena, ALLEGRO_SAMPLE_INSTANCE** slot) {
+	TrackMeasuredResource(arena, slot, ReleaseTrackedSampleInstance, MeasureTrackedSampleInstance);
+}
+
+void TrackSoundEffect(struct Arena* arena, int* slot) {
+	TrackResource(arena, slot, ReleaseTrackedSoundEffect);
+}
+
+void TrackTimeline(struct Arena* arena, struct Timeline** slot) {
+	TrackResource(arena, slot, ReleaseTrackedTimeline);
+}
+
+void TrackTimelineProfiler(struct Arena* arena, struct TimelineProfiler** slot) {
+	TrackResource(arena, slot, ReleaseTrackedTimelineProfiler);
+}
+
+void TrackTweenBatch(struct Arena* arena, struct TweenBatch** slot) {
+	TrackResource(arena, slot, ReleaseTrackedTweenBatch);
+}
+
+void TrackSheetStreamer(struct Arena* arena, struct SheetStreamer** slot) {
+	TrackResource(arena, slot, ReleaseTrackedSheetStreamer);
+}
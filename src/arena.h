@@ -0,0 +1,91 @@
+/*! \file arena.h
+ *  \brief Memory and resources that live as long as a gamestate.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_ARENA_H
+#define WAKEYWAKEY_ARENA_H
+
+#include <libsuperderpy.h>
+
+struct SheetStreamer;
+struct TimelineProfiler;
+struct TweenBatch;
+
+#define ARENA_BLOCK_SIZE 16384
+
+struct ArenaBlock {
+	struct ArenaBlock* next;
+	size_t size, used;
+	_Alignas(16) unsigned char data[];
+};
+
+struct TrackedResource {
+	void* slot; // where the gamestate keeps it, so it can be replaced (or still be NULL) later on
+	void (*release)(struct Game* game, void* slot);
+	size_t (*measure)(void* slot); // estimated size in bytes, NULL when not worth counting
+};
+
+/*! \brief Everything a gamestate allocates between Gamestate_Load and Gamestate_Unload.
+ *
+ * CPU allocations come from ArenaAlloc and go away all at once. Allegro objects (and our
+ * own cached ones) are registered with the Track* functions by the address of the field
+ * holding them, and are released in the reverse order by DestroyArena, so anything created
+ * from something else goes first. In debug mode, DestroyArena also reports bitmap references
+ * and sample instances that are still around compared to when the arena was created.
+ *
+ * Gamestates hand their arena over to PublishArena at the end of Gamestate_PostLoad, which
+ * links it in CommonResources, so the residency report can tell what each gamestate holds;
+ * see MeasureArena. That happens on the main thread, where the report runs, once nothing
+ * gets tracked from the loading thread anymore.
+ */
+struct Arena {
+	char* name;
+	struct ArenaBlock* blocks;
+	size_t allocated;
+
+	struct TrackedResource* resources;
+	int count, capacity;
+
+	int bitmapRefs, sampleInstances; // at creation, for the leak report
+
+	struct Arena* next;
+};
+
+struct Arena* CreateArena(struct Game* game, const char* name);
+void DestroyArena(struct Game* game, struct Arena* arena);
+void* ArenaAlloc(struct Arena* arena, size_t size);
+void PublishArena(struct Game* game, struct Arena* arena);
+struct Arena* FindArena(struct Game* game, const char* name);
+size_t MeasureArena(struct Arena* arena);
+
+void TrackResource(struct Arena* arena, void* slot, void (*release)(struct Game* game, void* slot));
+void TrackBitmap(struct Arena* arena, ALLEGRO_BITMAP** slot);
+void TrackCachedBitmap(struct Arena* arena, ALLEGRO_BITMAP** slot);
+void TrackCharacter(struct Arena* arena, struct Character** slot);
+void TrackShader(struct Arena* arena, ALLEGRO_SHADER** slot);
+void TrackFont(struct Arena* arena, ALLEGRO_FONT** slot);
+void TrackAudioStream(struct Arena* arena, ALLEGRO_AUDIO_STREAM** slot);
+void TrackSampleInstance(struct Arena* arena, ALLEGRO_SAMPLE_INSTANCE** slot);
+void TrackSoundEffect(struct Arena* arena, int* slot);
+void TrackTimeline(struct Arena* arena, struct Timeline** slot);
+void TrackTimelineProfiler(struct Arena* arena, struct TimelineProfiler** slot);
+void TrackTweenBatch(struct Arena* arena, struct TweenBatch** slot);
+void TrackSheetStreamer(struct Arena* arena, struct SheetStreamer** slot);
+
+#endif
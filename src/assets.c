@@ -0,0 +1,58 @@
+/*! \file assets.c
+ *  \brief What the board loads, shared with its prefetch.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+const struct BoardAsset BoardImages[BOARD_IMAGE_COUNT] = {
+	[BOARD_BG] = {"bg.png"},
+	[BOARD_GROUND] = {"trawka.png"},
+	[BOARD_SKY] = {"sky.png"},
+	[BOARD_WATER] = {"water.png"},
+	[BOARD_LOGO] = {"logo.png"},
+	[BOARD_MENU] = {"menu.png"},
+	[BOARD_STANDBY] = {"pliszka_standbyX.png", 6},
+	[BOARD_MOVING] = {"pliszka_w_locieX.png", 6},
+	[BOARD_PAWN] = {"czapeczka_kolorX.png", 6},
+	[BOARD_CLOUD] = {"chmurka_z_cieniemX.png", 3},
+	[BOARD_BADCLOUD] = {"chmurka_czerwonaX.png", 3},
+	[BOARD_GOODCLOUD] = {"chmurka_zielonaX.png", 3},
+};
+
+const struct BoardAsset BoardCharacters[BOARD_CHARACTER_COUNT] = {
+	[BOARD_FG] = {"fg", 0, {"shine", "stand"}},
+	[BOARD_GOOSE] = {"gesX", 3, {"quack", "sleep", "stand", "wakeup", "walk", "buch"}},
+};
+
+const char* GetBoardImagePath(struct Game* game, enum BoardImage image, int i) {
+	// i counts from 0; the result is owned by the engine, just like what PunchNumber returns
+	const struct BoardAsset* asset = &BoardImages[image];
+	return asset->count ? PunchNumber(game, asset->path, 'X', i + 1) : asset->path;
+}
+
+struct Character* CreateBoardCharacter(struct Game* game, enum BoardCharacter character, int i) {
+	// with its spritesheets registered, but nothing loaded yet
+	const struct BoardAsset* asset = &BoardCharacters[character];
+	struct Character* c = CreateCharacter(game, asset->count ? PunchNumber(game, asset->path, 'X', i + 1) : asset->path);
+	for (int s = 0; asset->sheets[s]; s++) {
+		RegisterCompiledSpritesheet(game, c, asset->sheets[s]);
+	}
+	return c;
+}
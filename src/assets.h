@@ -0,0 +1,66 @@
+/*! \file assets.h
+ *  \brief What the board loads, shared with its prefetch.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_ASSETS_H
+#define WAKEYWAKEY_ASSETS_H
+
+#include <libsuperderpy.h>
+
+enum BoardImage {
+	BOARD_BG,
+	BOARD_GROUND,
+	BOARD_SKY,
+	BOARD_WATER,
+	BOARD_LOGO,
+	BOARD_MENU,
+	BOARD_STANDBY, // one per player
+	BOARD_MOVING,
+	BOARD_PAWN,
+	BOARD_CLOUD, // one per size
+	BOARD_BADCLOUD,
+	BOARD_GOODCLOUD,
+	BOARD_IMAGE_COUNT
+};
+
+enum BoardCharacter {
+	BOARD_FG,
+	BOARD_GOOSE, // one per goose
+	BOARD_CHARACTER_COUNT
+};
+
+/*! \brief An image (or a numbered set of them) loaded by the board.
+ *
+ * The board's Gamestate_Load and the prefetch started from main.c both go through these
+ * tables, so whatever the board loads is what gets prefetched. With a count, the X in the
+ * path gets replaced with 1..count.
+ */
+struct BoardAsset {
+	const char* path;
+	int count; // 0 for a single one
+	const char* sheets[8]; // characters only, NULL-terminated
+};
+
+extern const struct BoardAsset BoardImages[BOARD_IMAGE_COUNT];
+extern const struct BoardAsset BoardCharacters[BOARD_CHARACTER_COUNT];
+
+const char* GetBoardImagePath(struct Game* game, enum BoardImage image, int i);
+struct Character* CreateBoardCharacter(struct Game* game, enum BoardCharacter character, int i);
+
+#endif
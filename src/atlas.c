@@ -0,0 +1,249 @@
+/*! \file atlas.c
+ *  \brief Prebuilt texture atlases for character spritesheets.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+struct Atlas* OpenAtlas(struct Game* game, const char* name) {
+	// Reads the manifest only; pages stay NULL until someone loads them.
+	char path[255];
+	snprintf(path, 255, "sprites/%s/atlas.ini", name);
+	ALLEGRO_CONFIG* manifest = LoadDataConfig(game, path);
+	if (!manifest) {
+		return NULL;
+	}
+
+	struct Atlas* atlas = calloc(1, sizeof(struct Atlas));
+	atlas->name = strdup(name);
+	atlas->manifest = manifest;
+	const char* pages = al_get_config_value(manifest, "atlas", "pages");
+	atlas->pageCount = pages ? strtol(pages, NULL, 10) : 0;
+	atlas->pages = calloc(atlas->pageCount, sizeof(ALLEGRO_BITMAP*));
+	return atlas;
+}
+
+const char* GetAtlasPagePath(struct Atlas* atlas, int i) {
+	// the result is only valid until the next call
+	static char path[255];
+	char key[16];
+	snprintf(key, 16, "page%d", i);
+	const char* page = al_get_config_value(atlas->manifest, "atlas", key);
+	if (!page) {
+		return NULL;
+	}
+	snprintf(path, 255, "sprites/%s/%s", atlas->name, page);
+	return path;
+}
+
+struct Atlas* LoadAtlas(struct Game* game, const char* name) {
+	struct Atlas* atlas = OpenAtlas(game, name);
+	if (!atlas) {
+		return NULL;
+	}
+	for (int i = 0; i < atlas->pageCount; i++) {
+		const char* path = GetAtlasPagePath(atlas, i);
+		if (path) {
+			atlas->pages[i] = AcquireBitmap(game, path);
+		}
+		if (!atlas->pages[i]) {
+			PrintConsole(game, "Atlas for %s is broken (page %d), ignoring it.", name, i);
+			DestroyAtlas(game, atlas);
+			return NULL;
+		}
+	}
+
+	PrintConsole(game, "Loaded atlas for %s (%d page(s)).", name, atlas->pageCount);
+	return atlas;
+}
+
+bool GetAtlasRect(struct Atlas* atlas, const char* file, int* page, int* x, int* y, int* w, int* h) {
+	const char* p = al_get_config_value(atlas->manifest, file, "page");
+	const char* px = al_get_config_value(atlas->manifest, file, "x");
+	const char* py = al_get_config_value(atlas->manifest, file, "y");
+	const char* pw = al_get_config_value(atlas->manifest, file, "w");
+	const char* ph = al_get_config_value(atlas->manifest, file, "h");
+	if (!p || !px || !py || !pw || !ph) {
+		return false;
+	}
+	*page = strtol(p, NULL, 10);
+	*x = strtol(px, NULL, 10);
+	*y = strtol(py, NULL, 10);
+	*w = strtol(pw, NULL, 10);
+	*h = strtol(ph, NULL, 10);
+	return *page >= 0 && *page < atlas->pageCount;
+}
+
+static bool CoversCharacter(struct Game* game, struct Atlas* atlas, struct Character* character) {
+	int page, x, y, w, h;
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		for (int i = 0; i < s->frameCount; i++) {
+			if (!s->frames[i].file || !GetAtlasRect(atlas, s->frames[i].file, &page, &x, &y, &w, &h)) {
+				PrintConsole(game, "Atlas for %s doesn't cover %s/%d, ignoring it.", atlas->name, s->name, i);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool ApplyAtlas(struct Game* game, struct Atlas* atlas, struct Character* character, void (*progress)(struct Game*)) {
+	// make sure that every frame is covered before touching anything, so we can fall back cleanly
+	if (!CoversCharacter(game, atlas, character)) {
+		return false;
+	}
+	for (int i = 0; i < atlas->pageCount; i++) {
+		if (!atlas->pages[i]) {
+			PrintConsole(game, "Atlas for %s is broken (page %d), ignoring it.", atlas->name, i);
+			return false;
+		}
+	}
+
+	// every frame becomes a sub-bitmap of a shared page, so consecutive frames don't need a texture switch
+	int page, x, y, w, h;
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		for (int i = 0; i < s->frameCount; i++) {
+			GetAtlasRect(atlas, s->frames[i].file, &page, &x, &y, &w, &h);
+			s->frames[i].bitmap = al_create_sub_bitmap(atlas->pages[page], x, y, w, h);
+			RetainBitmap(game, atlas->pages[page]);
+			if (i == 0) {
+				s->width = w;
+				s->height = h;
+			}
+		}
+		if (progress) {
+			progress(game);
+		}
+	}
+	return true;
+}
+
+struct Atlas* QueueCharacterSpritesheets(struct Game* game, struct AssetLoader* loader, struct Character* character, void (*progress)(struct Game*)) {
+	// Queues the atlas pages of the character on the loader; pass the result to FinishCharacterSpritesheets
+	// once it's done.
+	// Without an atlas, the character gets loaded right away. Either way, one progress step per spritesheet
+	// gets reported (by the loader when the pages are done, or here).
+	int sheets = 0;
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		sheets++;
+	}
+	struct Atlas* atlas = OpenAtlas(game, character->name);
+	if (!atlas || !atlas->pageCount || !CoversCharacter(game, atlas, character)) {
+		DestroyAtlas(game, atlas);
+		LoadCharacterFrames(game, character, progress);
+		return NULL;
+	}
+	for (int i = 0; i < atlas->pageCount; i++) {
+		const char* path = GetAtlasPagePath(atlas, i);
+		int steps = sheets / atlas->pageCount + (i == atlas->pageCount - 1 ? sheets % atlas->pageCount : 0);
+		if (path) {
+			QueueBitmap(loader, &atlas->pages[i], path, steps);
+		} else {
+			for (int s = 0; s < steps; s++) {
+				progress(game);
+			}
+		}
+	}
+	return atlas;
+}
+
+void FinishCharacterSpritesheets(struct Game* game, struct Atlas* atlas, struct Character* character) {
+	if (!atlas) {
+		return;
+	}
+	if (!ApplyAtlas(game, atlas, character, NULL)) {
+		LoadCharacterFrames(game, character, NULL);
+	}
+	DestroyAtlas(game, atlas);
+}
+
+void LoadCharacterFrames(struct Game* game, struct Character* character, void (*progress)(struct Game*)) {
+	// Loads loose frame files through the bitmap cache, so frames shared between spritesheets
+	// (or characters) are only decoded once. Every frame is a sub-bitmap holding a reference,
+	// just like with atlases.
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		for (int i = 0; i < s->frameCount; i++) {
+			if (!s->frames[i].file) {
+				// not a per-frame spritesheet; let the engine handle it
+				LoadSpritesheets(game, character, progress);
+				return;
+			}
+		}
+	}
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		for (int i = 0; i < s->frameCount; i++) {
+			char path[255];
+			snprintf(path, 255, "sprites/%s/%s", character->name, s->frames[i].file);
+			ALLEGRO_BITMAP* bitmap = AcquireBitmap(game, path);
+			if (!bitmap) {
+				PrintConsole(game, "Could not load %s!", path);
+				continue;
+			}
+			s->frames[i].bitmap = al_create_sub_bitmap(bitmap, 0, 0, al_get_bitmap_width(bitmap), al_get_bitmap_height(bitmap));
+			if (i == 0) {
+				s->width = al_get_bitmap_width(bitmap);
+				s->height = al_get_bitmap_height(bitmap);
+			}
+		}
+		if (progress) {
+			progress(game);
+		}
+	}
+}
+
+void LoadCharacterSpritesheets(struct Game* game, struct Character* character, void (*progress)(struct Game*)) {
+	// Drop-in replacement for LoadSpritesheets; use ReleaseCharacter to get rid of the character.
+	// Reports progress once per spritesheet either way, so Gamestate_ProgressCount stays the same
+	// regardless of which path gets taken.
+	struct Atlas* atlas = LoadAtlas(game, character->name);
+	if (!atlas || !ApplyAtlas(game, atlas, character, progress)) {
+		LoadCharacterFrames(game, character, progress);
+	}
+	DestroyAtlas(game, atlas);
+}
+
+void LoadSharedSpritesheets(struct Game* game, struct Character** characters, int count) {
+	// Like LoadCharacterSpritesheets for a bunch of characters of the same kind, with the atlas
+	// loaded just once for all of them.
+	if (!count) {
+		return;
+	}
+	struct Atlas* atlas = LoadAtlas(game, characters[0]->name);
+	for (int i = 0; i < count; i++) {
+		if (!atlas || !ApplyAtlas(game, atlas, characters[i], NULL)) {
+			LoadCharacterFrames(game, characters[i], NULL);
+		}
+	}
+	DestroyAtlas(game, atlas);
+}
+
+void DestroyAtlas(struct Game* game, struct Atlas* atlas) {
+	// Frames created from the atlas hold their own references to the pages, so it's fine
+	// to get rid of the atlas as soon as it has been applied.
+	if (!atlas) {
+		return;
+	}
+	for (int i = 0; i < atlas->pageCount; i++) {
+		ReleaseBitmap(game, atlas->pages[i]);
+	}
+	al_destroy_config(atlas->manifest);
+	free(atlas->pages);
+	free(atlas->name);
+	free(atlas);
+}
@@ -0,0 +1,47 @@
+/*! \file atlas.h
+ *  \brief Prebuilt texture atlases for character spritesheets.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_ATLAS_H
+#define WAKEYWAKEY_ATLAS_H
+
+#include "loader.h"
+#include <libsuperderpy.h>
+
+/*! \brief Atlas pages generated by tools/atlas for a single character. */
+struct Atlas {
+	char* name;
+	int pageCount;
+	ALLEGRO_BITMAP** pages;
+	ALLEGRO_CONFIG* manifest;
+};
+
+struct Atlas* OpenAtlas(struct Game* game, const char* name);
+struct Atlas* LoadAtlas(struct Game* game, const char* name);
+const char* GetAtlasPagePath(struct Atlas* atlas, int i);
+bool GetAtlasRect(struct Atlas* atlas, const char* file, int* page, int* x, int* y, int* w, int* h);
+bool ApplyAtlas(struct Game* game, struct Atlas* atlas, struct Character* character, void (*progress)(struct Game*));
+void LoadCharacterFrames(struct Game* game, struct Character* character, void (*progress)(struct Game*));
+void LoadCharacterSpritesheets(struct Game* game, struct Character* character, void (*progress)(struct Game*));
+void LoadSharedSpritesheets(struct Game* game, struct Character** characters, int count);
+struct Atlas* QueueCharacterSpritesheets(struct Game* game, struct AssetLoader* loader, struct Character* character, void (*progress)(struct Game*));
+void FinishCharacterSpritesheets(struct Game* game, struct Atlas* atlas, struct Character* character);
+void DestroyAtlas(struct Game* game, struct Atlas* atlas);
+
+#endif
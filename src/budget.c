@@ -0,0 +1,116 @@
+/*! \file budget.c
+ *  \brief Memory budget for bitmaps and samples.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+struct MemoryBudget* CreateMemoryBudget(struct Game* game) {
+	struct MemoryBudget* budget = calloc(1, sizeof(struct MemoryBudget));
+	game->data->budget = budget;
+	SetMemoryBudget(game, strtod(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "memory_budget", "0"), NULL));
+	return budget;
+}
+
+void DestroyMemoryBudget(struct Game* game, struct MemoryBudget* budget) {
+	PrintMemoryBudgetStats(game);
+	free(budget);
+}
+
+void SetMemoryBudget(struct Game* game, double megabytes) {
+	struct MemoryBudget* budget = game->data->budget;
+	budget->limit = megabytes > 0 ? (size_t)(megabytes * 1048576.0) : 0;
+	budget->exhausted = false;
+	if (budget->limit) {
+		PrintConsole(game, "Memory budget: %.1f MB for bitmaps and samples.", megabytes);
+	}
+}
+
+size_t GetMemoryUsage(struct Game* game) {
+	size_t usage = 0;
+	al_lock_mutex(game->data->cache->mutex);
+	usage += game->data->cache->resident;
+	al_unlock_mutex(game->data->cache->mutex);
+	al_lock_mutex(game->data->sounds->mutex);
+	usage += game->data->sounds->resident;
+	al_unlock_mutex(game->data->sounds->mutex);
+	return usage;
+}
+
+static bool EvictLeastRecent(struct Game* game) {
+	// Sheet ages are in logic time and sample ages in wall time, which is close enough for this.
+	struct MemoryBudget* budget = game->data->budget;
+	struct SheetStreamer* streamer = NULL;
+	int sheet = -1;
+	double oldest = -1.0, age;
+	for (struct SheetStreamer* s = game->data->streamers; s; s = s->next) {
+		int i = FindLeastRecentSheet(s, MEMORY_BUDGET_GRACE, &age);
+		if (i >= 0 && age > oldest) {
+			streamer = s;
+			sheet = i;
+			oldest = age;
+		}
+	}
+	struct SoundEntry* sample = FindLeastRecentSample(game, MEMORY_BUDGET_GRACE, &age);
+	if (sample && age > oldest) {
+		EvictSample(game, sample);
+		budget->sampleEvictions++;
+		return true;
+	}
+	if (streamer) {
+		EvictStreamedSheet(streamer, sheet);
+		budget->bitmapEvictions++;
+		return true;
+	}
+	return false;
+}
+
+void UpdateMemoryBudget(struct Game* game) {
+	// Runs after the gamestates' logic, so anything requested this frame is already marked as used.
+	struct MemoryBudget* budget = game->data->budget;
+	size_t usage = GetMemoryUsage(game);
+	// sampled once per frame; the cache and the registry keep their own exact peaks
+	if (usage > budget->peak) {
+		budget->peak = usage;
+	}
+	if (!budget->limit) {
+		return;
+	}
+	while (usage > budget->limit) {
+		if (!EvictLeastRecent(game)) {
+			if (!budget->exhausted) {
+				PrintConsole(game, "Memory budget exceeded by %zu KB with nothing left to evict!", (usage - budget->limit) / 1024);
+				budget->exhausted = true;
+			}
+			return;
+		}
+		usage = GetMemoryUsage(game);
+	}
+	budget->exhausted = false;
+}
+
+void PrintMemoryBudgetStats(struct Game* game) {
+	struct MemoryBudget* budget = game->data->budget;
+	char limit[32] = "none";
+	if (budget->limit) {
+		snprintf(limit, 32, "%.1f MB", budget->limit / 1048576.0);
+	}
+	PrintConsole(game, "Memory budget: %.1f MB used, peak %.1f MB, limit %s; evicted %d spritesheet(s) and %d sample(s).",
+		GetMemoryUsage(game) / 1048576.0, budget->peak / 1048576.0, limit, budget->bitmapEvictions, budget->sampleEvictions);
+}
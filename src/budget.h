@@ -0,0 +1,54 @@
+/*! \file budget.h
+ *  \brief Memory budget for bitmaps and samples.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_BUDGET_H
+#define WAKEYWAKEY_BUDGET_H
+
+#include <libsuperderpy.h>
+
+// assets used more recently than that are considered to be still on screen (or playing)
+#define MEMORY_BUDGET_GRACE 0.5
+
+/*! \brief Keeps resident bitmaps and samples under [WakeyWakey] memory_budget (in MB).
+ *
+ * Usage is what the bitmap cache and the sound registry hold. When it goes over the limit,
+ * UpdateMemoryBudget evicts whatever hasn't been used for the longest time among the assets
+ * that can be brought back on their own: streamed spritesheets (reloaded on their next
+ * RequestSheet) and samples that aren't playing (decoded again on their next play).
+ * Everything else a gamestate holds counts towards the budget, but stays put.
+ *
+ * With no budget set (the default), only the peak usage is tracked.
+ */
+struct MemoryBudget {
+	size_t limit; // in bytes, 0 for none
+	size_t peak;
+	int bitmapEvictions, sampleEvictions;
+	bool exhausted; // over the limit with nothing left to evict; reported once each time
+};
+
+struct MemoryBudget* CreateMemoryBudget(struct Game* game);
+void DestroyMemoryBudget(struct Game* game, struct MemoryBudget* budget);
+
+void SetMemoryBudget(struct Game* game, double megabytes);
+size_t GetMemoryUsage(struct Game* game);
+void UpdateMemoryBudget(struct Game* game);
+void PrintMemoryBudgetStats(struct Game* game);
+
+#endif
@@ -0,0 +1,208 @@
+/*! \file cache.c
+ *  \brief Reference counted bitmap cache shared by all gamestates.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// Every bitmap loaded from the data directory goes through here, keyed by its path,
+// so an asset used by several characters or gamestates is decoded and uploaded once.
+// It's used from loader threads too, hence the mutex.
+
+struct BitmapCache* CreateBitmapCache(void) {
+	struct BitmapCache* cache = calloc(1, sizeof(struct BitmapCache));
+	cache->mutex = al_create_mutex();
+	return cache;
+}
+
+void DestroyBitmapCache(struct Game* game, struct BitmapCache* cache) {
+	PrintCacheStats(game);
+	struct CacheEntry* entry = cache->entries;
+	while (entry) {
+		struct CacheEntry* next = entry->next;
+		PrintConsole(game, "Bitmap %s still has %d reference(s) at exit.", entry->path, entry->refs);
+		al_destroy_bitmap(entry->bitmap);
+		free(entry->path);
+		free(entry);
+		entry = next;
+	}
+	al_destroy_mutex(cache->mutex);
+	free(cache);
+}
+
+static struct CacheEntry* FindByPath(struct BitmapCache* cache, const char* path) {
+	for (struct CacheEntry* entry = cache->entries; entry; entry = entry->next) {
+		if (strcmp(entry->path, path) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static struct CacheEntry* FindByBitmap(struct BitmapCache* cache, ALLEGRO_BITMAP* bitmap) {
+	for (struct CacheEntry* entry = cache->entries; entry; entry = entry->next) {
+		if (entry->bitmap == bitmap) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+ALLEGRO_BITMAP* LookupBitmap(struct Game* game, const char* path) {
+	// Returns a new reference to an already loaded bitmap, or NULL when it has to be loaded.
+	struct BitmapCache* cache = game->data->cache;
+	ALLEGRO_BITMAP* bitmap = NULL;
+	al_lock_mutex(cache->mutex);
+	struct CacheEntry* entry = FindByPath(cache, path);
+	if (entry) {
+		entry->refs++;
+		cache->hits++;
+		bitmap = entry->bitmap;
+	}
+	al_unlock_mutex(cache->mutex);
+	return bitmap;
+}
+
+ALLEGRO_BITMAP* StoreBitmap(struct Game* game, const char* path, ALLEGRO_BITMAP* bitmap) {
+	// Takes ownership of a freshly loaded bitmap and returns a reference to the cached one.
+	// If someone else managed to load the same file in the meantime, theirs wins.
+	struct BitmapCache* cache = game->data->cache;
+	if (!bitmap) {
+		return NULL;
+	}
+	al_lock_mutex(cache->mutex);
+	struct CacheEntry* entry = FindByPath(cache, path);
+	if (entry) {
+		entry->refs++;
+		cache->hits++;
+		al_unlock_mutex(cache->mutex);
+		al_destroy_bitmap(bitmap);
+		return entry->bitmap;
+	}
+	entry = calloc(1, sizeof(struct CacheEntry));
+	entry->path = strdup(path);
+	entry->bitmap = bitmap;
+	entry->refs = 1;
+	entry->size = (size_t)al_get_bitmap_width(bitmap) * al_get_bitmap_height(bitmap) * 4;
+	entry->next = cache->entries;
+	cache->entries = entry;
+	cache->misses++;
+	cache->resident += entry->size;
+	if (cache->resident > cache->peak) {
+		cache->peak = cache->resident;
+	}
+	al_unlock_mutex(cache->mutex);
+	return bitmap;
+}
+
+ALLEGRO_BITMAP* AcquireBitmap(struct Game* game, const char* path) {
+	ALLEGRO_BITMAP* bitmap = LookupBitmap(game, path);
+	if (bitmap) {
+		return bitmap;
+	}
+	return StoreBitmap(game, path, LoadDataBitmap(game, path));
+}
+
+void RetainBitmap(struct Game* game, ALLEGRO_BITMAP* bitmap) {
+	struct BitmapCache* cache = game->data->cache;
+	al_lock_mutex(cache->mutex);
+	struct CacheEntry* entry = FindByBitmap(cache, bitmap);
+	if (entry) {
+		entry->refs++;
+	}
+	al_unlock_mutex(cache->mutex);
+}
+
+void ReleaseBitmap(struct Game* game, ALLEGRO_BITMAP* bitmap) {
+	struct BitmapCache* cache = game->data->cache;
+	if (!bitmap) {
+		return;
+	}
+	al_lock_mutex(cache->mutex);
+	struct CacheEntry** prev = &cache->entries;
+	for (struct CacheEntry* entry = cache->entries; entry; entry = entry->next) {
+		if (entry->bitmap == bitmap) {
+			entry->refs--;
+			if (!entry->refs) {
+				*prev = entry->next;
+				cache->resident -= entry->size;
+				al_destroy_bitmap(entry->bitmap);
+				free(entry->path);
+				free(entry);
+			}
+			al_unlock_mutex(cache->mutex);
+			return;
+		}
+		prev = &entry->next;
+	}
+	al_unlock_mutex(cache->mutex);
+	PrintConsole(game, "Tried to release a bitmap that isn't in the cache!");
+}
+
+int CountBitmapReferences(struct Game* game) {
+	struct BitmapCache* cache = game->data->cache;
+	int refs = 0;
+	al_lock_mutex(cache->mutex);
+	for (struct CacheEntry* entry = cache->entries; entry; entry = entry->next) {
+		refs += entry->refs;
+	}
+	al_unlock_mutex(cache->mutex);
+	return refs;
+}
+
+void PrintCacheStats(struct Game* game) {
+	struct BitmapCache* cache = game->data->cache;
+	al_lock_mutex(cache->mutex);
+	int count = 0;
+	for (struct CacheEntry* entry = cache->entries; entry; entry = entry->next) {
+		count++;
+	}
+	PrintConsole(game, "Bitmap cache: %d hit(s), %d miss(es), %d bitmap(s) resident taking %.1f MB (peak %.1f MB).",
+		cache->hits, cache->misses, count, cache->resident / 1048576.0, cache->peak / 1048576.0);
+	al_unlock_mutex(cache->mutex);
+}
+
+void ReleaseCharacter(struct Game* game, struct Character* character) {
+	// Use instead of DestroyCharacter for characters set up with LoadCharacterSpritesheets.
+	// Their frames are sub-bitmaps of cached bitmaps and each one holds a reference to its parent.
+	int count = 0;
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		count += s->frameCount;
+	}
+	ALLEGRO_BITMAP** parents = calloc(count, sizeof(ALLEGRO_BITMAP*));
+	int i = 0;
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		for (int f = 0; f < s->frameCount; f++) {
+			if (s->frames[f].bitmap && al_is_sub_bitmap(s->frames[f].bitmap)) {
+				ALLEGRO_BITMAP* parent = al_get_parent_bitmap(s->frames[f].bitmap);
+				al_lock_mutex(game->data->cache->mutex);
+				if (FindByBitmap(game->data->cache, parent)) {
+					parents[i++] = parent;
+				}
+				al_unlock_mutex(game->data->cache->mutex);
+			}
+		}
+	}
+	// sub-bitmaps have to go before their parents
+	DestroyCharacter(game, character);
+	for (int p = 0; p < i; p++) {
+		ReleaseBitmap(game, parents[p]);
+	}
+	free(parents);
+}
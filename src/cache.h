@@ -0,0 +1,54 @@
+/*! \file cache.h
+ *  \brief Reference counted bitmap cache shared by all gamestates.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_CACHE_H
+#define WAKEYWAKEY_CACHE_H
+
+#include <libsuperderpy.h>
+
+struct CacheEntry {
+	char* path; // relative to the data directory
+	ALLEGRO_BITMAP* bitmap;
+	int refs;
+	size_t size;
+	struct CacheEntry* next;
+};
+
+struct BitmapCache {
+	struct CacheEntry* entries;
+	ALLEGRO_MUTEX* mutex;
+	int hits, misses;
+	size_t resident, peak;
+};
+
+struct BitmapCache* CreateBitmapCache(void);
+void DestroyBitmapCache(struct Game* game, struct BitmapCache* cache);
+
+ALLEGRO_BITMAP* AcquireBitmap(struct Game* game, const char* path);
+ALLEGRO_BITMAP* LookupBitmap(struct Game* game, const char* path);
+ALLEGRO_BITMAP* StoreBitmap(struct Game* game, const char* path, ALLEGRO_BITMAP* bitmap);
+void RetainBitmap(struct Game* game, ALLEGRO_BITMAP* bitmap);
+void ReleaseBitmap(struct Game* game, ALLEGRO_BITMAP* bitmap);
+void PrintCacheStats(struct Game* game);
+int CountBitmapReferences(struct Game* game);
+
+void ReleaseCharacter(struct Game* game, struct Character* character);
+
+#endif
@@ -39,14 +39,54 @@ bool GlobalEventHandler(struct Game* game, ALLEGRO_EVENT* ev) {
 		PrintConsole(game, "Fullscreen toggled");
 	}
 
+	if ((ev->type == ALLEGRO_EVENT_KEY_DOWN) && (ev->keyboard.keycode == ALLEGRO_KEY_F3)) {
+		game->data->perf->visible = !game->data->perf->visible;
+	}
+
+	if ((ev->type == ALLEGRO_EVENT_KEY_DOWN) && (ev->keyboard.keycode == ALLEGRO_KEY_F4)) {
+		PrintResidencyReport(game);
+	}
+
+	ThrottleEvent(game, ev);
+
 	return false;
 }
 
+void GlobalPostLogic(struct Game* game, double delta) {
+	PerfPostLogic(game, delta);
+	UpdateThrottle(game);
+	UpdatePrefetch(game);
+	UpdateSounds(game);
+	UpdateResidency(game);
+	UpdateMemoryBudget(game);
+}
+
 struct CommonResources* CreateGameData(struct Game* game) {
 	struct CommonResources* data = calloc(1, sizeof(struct CommonResources));
+	data->pack = OpenAssetPack(game);
+	game->data = data; // the manifest may come from the pack, which is looked up through game->data
+	data->sprites = LoadSpriteManifest(game);
+	data->cache = CreateBitmapCache();
+	data->sounds = CreateSoundRegistry(game);
+	data->sfx = CreateSoundEffects(game);
+	data->budget = CreateMemoryBudget(game);
+	data->textures = strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "textures", "1"), NULL, 10);
+	data->perf = CreatePerf(game, GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "perf_csv", NULL));
+	data->throttle = CreateThrottle(game);
+	data->residency = CreateResidency(game);
 	return data;
 }
 
 void DestroyGameData(struct Game* game) {
+	FinishPrefetch(game); // in case the board never got loaded
+	DestroyResidency(game, game->data->residency);
+	DestroyThrottle(game, game->data->throttle);
+	DestroyPerf(game, game->data->perf);
+	DestroyMemoryBudget(game, game->data->budget);
+	DestroyBitmapCache(game, game->data->cache);
+	DestroySoundEffects(game, game->data->sfx); // its voices come from the registry
+	DestroySoundRegistry(game, game->data->sounds);
+	DestroySpriteManifest(game->data->sprites);
+	CloseAssetPack(game->data->pack); // only after everything that could still be reading from it
 	free(game->data);
 }
@@ -18,11 +18,53 @@
 #define LIBSUPERDERPY_DATA_TYPE struct CommonResources
 #include <libsuperderpy.h>
 
+#include "arena.h"
+#include "assets.h"
+#include "atlas.h"
+#include "budget.h"
+#include "cache.h"
+#include "loader.h"
+#include "pack.h"
+#include "perf.h"
+#include "prefetch.h"
+#include "profiler.h"
+#include "random.h"
+#include "residency.h"
+#include "sfx.h"
+#include "sounds.h"
+#include "sprites.h"
+#include "streamer.h"
+#include "texture.h"
+#include "throttle.h"
+#include "tweens.h"
+
+// config file section holding game-specific options
+#define GAME_CONFIG_SECTION "WakeyWakey"
+
 struct CommonResources {
 	// Fill in with common data accessible from all gamestates.
-	bool unused;
+	struct AssetPack* pack; // NULL when assets get loaded from loose files
+	struct BitmapCache* cache;
+	struct SoundRegistry* sounds;
+	struct SoundEffects* sfx;
+	struct MemoryBudget* budget; // [WakeyWakey] memory_budget or --memory-budget
+	struct SheetStreamer* streamers; // live ones, for the memory budget
+	struct SpriteManifest* sprites; // NULL when spritesheets get read from their INIs
+	bool textures; // use .tex files made by tools/texconv; [WakeyWakey] textures or --no-textures
+	struct PerfOverlay* perf;
+	struct FrameThrottle* throttle;
+	struct Prefetch* prefetch; // board images decoded during the intros, see main.c
+	struct Residency* residency; // which gamestates stay loaded, set up in main.c
+	struct Arena* arenas; // of the loaded gamestates, for the residency report
+
+	uint64_t seed; // --seed or [WakeyWakey] seed; gamestates seed their own streams from it
+
+	bool headless; // --headless: board runs its logic as fast as possible, without drawing
+	const char* script; // scripted input for headless runs, NULL to just keep pressing space
+	bool benchStartup; // --bench-startup: straight to the board, quit after its first frame; see tools/startbench.sh
 };
 
 struct CommonResources* CreateGameData(struct Game* game);
 void DestroyGameData(struct Game* game);
 bool GlobalEventHandler(struct Game* game, ALLEGRO_EVENT* ev);
+void GlobalPostLogic(struct Game* game, double delta);
@@ -19,22 +19,35 @@
  */
 
 #include "../common.h"
+#include <allegro5/allegro_opengl.h>
 #include <libsuperderpy.h>
 
 #define COLS 6.0
 #define ROWS 8.0
 
+// profiled actions in flight on the "rounds" timeline; a sleeping cutscene queues up to eight,
+// with room left for turns queued behind it
+#define ROUNDS_ACTION_POOL 32
+
 struct Field {
 	int id;
 	bool dreamy;
 	struct Dream {
-		struct Tween displacement, size;
 		bool good;
 		struct Character* content;
 		int id;
 	} dream;
 };
 
+struct Cell {
+	int num; // index of the field drawn in this cell (the board goes in a serpentine)
+	float x, y;
+	float bob; // frequency of the idle bobbing
+	// dream cloud placement as computed for the current frame, reused by the fb pass
+	float dreamY, dreamScale;
+	int dreamFrame;
+};
+
 struct Player {
 	int id;
 	int position;
@@ -59,6 +72,9 @@ struct Goose {
 	struct Tween position;
 	struct Character* character;
 	bool flipped;
+	// rolled in WakeUp, so the dream can be streamed in before Snort shows it
+	bool good;
+	int dream;
 };
 
 struct GamestateResources {
@@ -70,9 +86,18 @@ struct GamestateResources {
 		struct Character* fg;
 	} layers;
 
+	// bg and ground flattened for the camera position in backdropScroll, see UpdateBackdrop
+	ALLEGRO_BITMAP* backdrop;
+	float backdropScroll;
+	float lastScroll; // camera position in the previous frame
+
 	ALLEGRO_BITMAP* cloud[3];
 	ALLEGRO_BITMAP* badcloud[3];
 	ALLEGRO_BITMAP* goodcloud[3];
+	ALLEGRO_BITMAP* clouds; // all cloud variants above are sub-bitmaps of this sheet
+
+	struct Cell cells[(int)COLS * (int)ROWS];
+	ALLEGRO_VERTEX cloudVertices[(int)COLS * (int)ROWS * 2 * 6];
 
 	struct Tween camera;
 
@@ -97,25 +122,74 @@ struct GamestateResources {
 	struct Field board[(int)COLS * (int)ROWS];
 
 	struct Timeline* timeline;
+	struct TimelineProfiler* profiler;
+	struct TweenBatch* dreamTweens; // size of every field's dream, then their displacement
+
+	struct Random rng; // reseeded on every start, so the same input plays out the same way
+	uint64_t games; // starts so far; mixed into the seed, so games in one session differ
+
+	struct SheetStreamer* dreamSheets; // NULL when dreams are loaded up front
 
-	struct Character* superdream;
+	// Every dream character is created up front, so Snort doesn't have to do it in the middle of
+	// an animation. There can't be more dreams than fields on the board.
+	struct DreamPool {
+		struct Character* all[(int)COLS * (int)ROWS];
+		struct Character* free[(int)COLS * (int)ROWS];
+		int available;
+	} dreams;
 
 	bool indream;
 
 	bool ended;
+	int turns; // moves made so far, reported by headless runs
 
-	ALLEGRO_BITMAP* fb;
+	ALLEGRO_BITMAP* fb; // only used when dreamShader isn't available
+	ALLEGRO_SHADER* dreamShader;
 
-	ALLEGRO_AUDIO_STREAM* music;
+	struct AssetLoader* loader; // alive between Gamestate_Load and Gamestate_PostLoad
+
+	struct Arena* arena; // holds this struct and everything loaded, see Gamestate_Unload
 
-	ALLEGRO_SAMPLE* ding_sample; // TODO: helper in engine
-	ALLEGRO_SAMPLE_INSTANCE* ding;
+	ALLEGRO_AUDIO_STREAM* music;
 
-	ALLEGRO_SAMPLE* tada_sample;
-	ALLEGRO_SAMPLE_INSTANCE* tada;
+	int ding, tada; // sound effects, see sfx.c
 };
 
-int Gamestate_ProgressCount = 59; // number of loading steps as reported by Gamestate_Load; 0 when missing
+int Gamestate_ProgressCount = 62; // number of loading steps as reported by Gamestate_Load; 0 when missing
+
+static inline int SizeTween(int field) {
+	return field;
+}
+
+static inline int DisplacementTween(int field) {
+	return COLS * ROWS + field;
+}
+
+// Draws a dream cloud with the dream content multiplied in, which is what the framebuffer
+// fallback achieves by drawing the content twice with ALLEGRO_DEST_COLOR, ALLEGRO_SRC_COLOR.
+static const char* DreamPixelShader =
+	"#ifdef GL_ES\n"
+	"precision mediump float;\n"
+	"#endif\n"
+	"uniform sampler2D al_tex;\n"
+	"uniform sampler2D dream_tex;\n"
+	"uniform vec4 cloud_rect;\n"
+	"uniform vec4 dream_rect;\n"
+	"uniform vec2 dream_scale;\n"
+	"varying vec4 varying_color;\n"
+	"varying vec2 varying_texcoord;\n"
+	"void main() {\n"
+	"  vec4 cloud = texture2D(al_tex, varying_texcoord) * varying_color;\n"
+	"  vec2 local = (varying_texcoord - cloud_rect.xy) / (cloud_rect.zw - cloud_rect.xy);\n"
+	"  vec2 pos = (local - 0.5) * dream_scale + 0.5;\n"
+	"  if (pos.x < 0.0 || pos.y < 0.0 || pos.x > 1.0 || pos.y > 1.0) {\n"
+	"    gl_FragColor = cloud;\n"
+	"    return;\n"
+	"  }\n"
+	"  vec4 dream = texture2D(dream_tex, mix(dream_rect.xy, dream_rect.zw, pos));\n"
+	"  vec4 pass = min(2.0 * dream * cloud, 1.0);\n"
+	"  gl_FragColor = min(2.0 * dream * pass, 1.0);\n"
+	"}\n";
 
 static TM_ACTION(HideMenu) {
 	TM_RunningOnly;
@@ -160,12 +234,13 @@ static void DoStartGame(struct Game* game, struct GamestateResources* data) {
 static TM_ACTION(EnlargeDream) {
 	switch (action->state) {
 		case TM_ACTIONSTATE_START:
-			data->board[data->currentPlayer->position].dream.size = Tween(game, 1.0, 2.0, TWEEN_STYLE_ELASTIC_OUT, 2.0);
+			SetTween(data->dreamTweens, SizeTween(data->currentPlayer->position), 1.0, 2.0, TWEEN_STYLE_ELASTIC_OUT, 2.0);
 			return false;
 		case TM_ACTIONSTATE_RUNNING:
-			UpdateTween(&data->board[data->currentPlayer->position].dream.size, action->delta);
-			return GetTweenPosition(&data->board[data->currentPlayer->position].dream.size) >= 0.6;
+			return GetBatchTweenPosition(data->dreamTweens, SizeTween(data->currentPlayer->position)) >= 0.6;
 		case TM_ACTIONSTATE_DESTROY:
+			// the dream stays enlarged where the tween was cut off
+			PauseTween(data->dreamTweens, SizeTween(data->currentPlayer->position));
 			data->currentPlayer->dreaming = true;
 			return false;
 		default:
@@ -176,14 +251,13 @@ static TM_ACTION(EnlargeDream) {
 static TM_ACTION(ShrinkDream) {
 	switch (action->state) {
 		case TM_ACTIONSTATE_START:
-			data->board[data->currentPlayer->position].dream.size = Tween(game, 2.0, 1.0, TWEEN_STYLE_ELASTIC_OUT, 2.0);
+			SetTween(data->dreamTweens, SizeTween(data->currentPlayer->position), 2.0, 1.0, TWEEN_STYLE_ELASTIC_OUT, 2.0);
 			data->currentPlayer->dreaming = false;
 			data->board[data->currentPlayer->position].dream.content->pos = 0.0;
 			AnimateCharacter(game, data->board[data->currentPlayer->position].dream.content, 0.0, 0.0);
 			return false;
 		case TM_ACTIONSTATE_RUNNING:
-			UpdateTween(&data->board[data->currentPlayer->position].dream.size, action->delta);
-			return GetTweenPosition(&data->board[data->currentPlayer->position].dream.size) >= 1.0;
+			return GetBatchTweenPosition(data->dreamTweens, SizeTween(data->currentPlayer->position)) >= 1.0;
 		default:
 			return false;
 	}
@@ -260,11 +334,11 @@ static void NextTurn(struct Game* game, struct GamestateResources* data) {
 
 		ScrollCamera(game, data);
 		TM_AddDelay(data->timeline, 500);
-		TM_AddAction(data->timeline, EnlargeDream, NULL);
+		AddProfiledAction(data->profiler, EnlargeDream, NULL, "EnlargeDream");
 		TM_AddDelay(data->timeline, 4000);
-		TM_AddAction(data->timeline, ShrinkDream, NULL);
-		TM_AddAction(data->timeline, ApplyDream, NULL);
-		TM_AddAction(data->timeline, StartTurn, NULL);
+		AddProfiledAction(data->profiler, ShrinkDream, NULL, "ShrinkDream");
+		AddProfiledAction(data->profiler, ApplyDream, NULL, "ApplyDream");
+		AddProfiledAction(data->profiler, StartTurn, NULL, "StartTurn");
 		return;
 	}
 	data->indream = false;
@@ -298,24 +372,24 @@ static void NextTurn(struct Game* game, struct GamestateResources* data) {
 	data->active = true;
 	ScrollCamera(game, data);
 
-	al_stop_sample_instance(data->ding);
-	al_play_sample_instance(data->ding);
+	PlaySoundEffect(game, data->ding);
 
 	if (data->board[data->currentPlayer->position].dreamy) {
 		data->active = false;
 		data->currentPlayer->beginning = true;
 
-		TM_AddAction(data->timeline, EnlargeDream, NULL);
+		AddProfiledAction(data->profiler, EnlargeDream, NULL, "EnlargeDream");
 		TM_AddDelay(data->timeline, 4000);
-		TM_AddAction(data->timeline, ShrinkDream, NULL);
-		TM_AddAction(data->timeline, ApplyDream, NULL);
-		TM_AddAction(data->timeline, StartTurn, NULL);
+		AddProfiledAction(data->profiler, ShrinkDream, NULL, "ShrinkDream");
+		AddProfiledAction(data->profiler, ApplyDream, NULL, "ApplyDream");
+		AddProfiledAction(data->profiler, StartTurn, NULL, "StartTurn");
 		return;
 	}
 }
 
 static void EndTura(struct Game* game, struct Tween* tween, void* d) {
 	struct GamestateResources* data = d;
+	data->turns++;
 	data->active = true;
 	data->currentPlayer->position = data->currentPlayer->selected;
 	data->currentPlayer->selected++;
@@ -356,12 +430,25 @@ static TM_ACTION(WakeUp) {
 	for (int i = 0; i < 3; i++) {
 		SelectSpritesheet(game, data->gooses[i].character, "wakeup");
 		do {
-			data->gooses[i].desired = rand() % (int)COLS;
+			data->gooses[i].desired = RandomInt(&data->rng, (int)COLS);
 		} while (data->gooses[i].desired == data->gooses[i].pos);
 		data->gooses[i].position = Tween(game, data->gooses[i].pos, data->gooses[i].desired, TWEEN_STYLE_LINEAR, 1.0 * abs(data->gooses[i].desired - data->gooses[i].pos) * (0.9 + i * 0.1));
 		data->gooses[i].position.callback = GoToSleep;
 		data->gooses[i].position.data = data->gooses[i].character;
 	}
+	// Snort used to roll these, right after everything above; the order is kept, so seeds
+	// still play out the same way.
+	for (int i = 0; i < 3; i++) {
+		int good[] = {2, 3, 4};
+		int bad[] = {1, 4, 5};
+		data->gooses[i].good = RandomInt(&data->rng, 2);
+		if (data->gooses[i].good) {
+			data->gooses[i].dream = good[RandomInt(&data->rng, 3)];
+		} else {
+			data->gooses[i].dream = bad[RandomInt(&data->rng, 3)];
+		}
+		RequestSheet(data->dreamSheets, PunchNumber(game, "senX", 'X', data->gooses[i].dream));
+	}
 	return true;
 }
 
@@ -394,36 +481,53 @@ static TM_ACTION(WaitForGeeseToSettle) {
 	}
 }
 
+static struct Character* CreateDream(struct Game* game) {
+	struct Character* dream = CreateCharacter(game, "dream");
+	for (int i = 1; i <= 5; i++) {
+		RegisterCompiledSpritesheet(game, dream, PunchNumber(game, "senX", 'X', i));
+	}
+	return dream;
+}
+
+static struct Character* TakeDream(struct Game* game, struct GamestateResources* data) {
+	if (!data->dreams.available) {
+		PrintConsole(game, "Dream pool exhausted!");
+		return NULL;
+	}
+	return data->dreams.free[--data->dreams.available];
+}
+
+static void ReturnDream(struct GamestateResources* data, struct Character* dream) {
+	data->dreams.free[data->dreams.available++] = dream;
+}
+
 static TM_ACTION(Snort) {
 	switch (action->state) {
 		case TM_ACTIONSTATE_START:
 			for (int i = 0; i < 3; i++) {
 				int pos = ((int)ROWS - 1) * (int)COLS + (COLS - 1 - data->gooses[i].pos);
-				data->board[pos].dreamy = true;
-				data->board[pos].dream.good = rand() % 2;
-				data->board[pos].dream.displacement = Tween(game, 0.0, 0.0, TWEEN_STYLE_LINEAR, 0.0); // TODO: add StaticTween helper
-				data->board[pos].dream.size = Tween(game, 0.0, 1.0, TWEEN_STYLE_ELASTIC_OUT, 2.0);
-				int good[] = {2, 3, 4};
-				int bad[] = {1, 4, 5};
-				int dream;
-				if (data->board[pos].dream.good) {
-					dream = good[rand() % 3];
-				} else {
-					dream = bad[rand() % 3];
+				if (!data->board[pos].dreamy) {
+					data->board[pos].dream.content = TakeDream(game, data);
+					if (!data->board[pos].dream.content) {
+						continue;
+					}
 				}
-				data->board[pos].dream.content = CreateCharacter(game, "dream");
-				data->board[pos].dream.content->shared = true;
-				data->board[pos].dream.content->spritesheets = data->superdream->spritesheets;
-				SelectSpritesheet(game, data->board[pos].dream.content, PunchNumber(game, "senX", 'X', dream));
-				data->board[pos].dream.id = dream;
+				data->board[pos].dreamy = true;
+				data->board[pos].dream.good = data->gooses[i].good;
+				SetStaticTween(data->dreamTweens, DisplacementTween(pos), 0.0);
+				SetTween(data->dreamTweens, SizeTween(pos), 0.0, 1.0, TWEEN_STYLE_ELASTIC_OUT, 2.0);
+				char name[] = "senX";
+				name[3] = '0' + data->gooses[i].dream;
+				RequestSheet(data->dreamSheets, name); // normally prefetched since WakeUp
+				SelectSpritesheet(game, data->board[pos].dream.content, name);
+				data->board[pos].dream.id = data->gooses[i].dream;
 			}
 			return false;
 		case TM_ACTIONSTATE_RUNNING: {
 			bool finished = true;
 			for (int i = 0; i < 3; i++) {
 				int pos = ((int)ROWS - 1) * (int)COLS + (COLS - 1 - data->gooses[i].pos);
-				UpdateTween(&data->board[pos].dream.size, action->delta);
-				if (GetTweenPosition(&data->board[pos].dream.size) < 1.0) {
+				if (GetBatchTweenPosition(data->dreamTweens, SizeTween(pos)) < 1.0) {
 					finished = false;
 				}
 			}
@@ -441,7 +545,7 @@ static TM_ACTION(MoveDreamsUp) {
 				if (!data->board[i].dreamy) {
 					continue;
 				}
-				data->board[i].dream.displacement = Tween(game, 0.0, 1.0, TWEEN_STYLE_SINE_IN_OUT, 2.0);
+				SetTween(data->dreamTweens, DisplacementTween(i), 0.0, 1.0, TWEEN_STYLE_SINE_IN_OUT, 2.0);
 			}
 			return false;
 		case TM_ACTIONSTATE_RUNNING: {
@@ -450,8 +554,7 @@ static TM_ACTION(MoveDreamsUp) {
 				if (!data->board[i].dreamy) {
 					continue;
 				}
-				UpdateTween(&data->board[i].dream.displacement, action->delta);
-				if (GetTweenPosition(&data->board[i].dream.displacement) < 1.0) {
+				if (GetBatchTweenPosition(data->dreamTweens, DisplacementTween(i)) < 1.0) {
 					finished = false;
 				}
 			}
@@ -463,7 +566,7 @@ static TM_ACTION(MoveDreamsUp) {
 					continue;
 				}
 				if (i < COLS) {
-					DestroyCharacter(game, data->board[i].dream.content);
+					ReturnDream(data, data->board[i].dream.content);
 					data->board[i].dreamy = false;
 				} else {
 					int x = i % (int)COLS;
@@ -474,7 +577,8 @@ static TM_ACTION(MoveDreamsUp) {
 					//}
 					data->board[i - diff].dream = data->board[i].dream;
 					data->board[i - diff].dreamy = data->board[i].dreamy;
-					data->board[i - diff].dream.displacement = Tween(game, 0.0, 0.0, TWEEN_STYLE_LINEAR, 0.0);
+					CopyTween(data->dreamTweens, SizeTween(i - diff), SizeTween(i));
+					SetStaticTween(data->dreamTweens, DisplacementTween(i - diff), 0.0);
 					data->board[i].dreamy = false;
 				}
 			}
@@ -498,7 +602,7 @@ static void PerformSleeping(struct Game* game, struct GamestateResources* data)
 
 		if (data->players[i].position >= COLS * (ROWS - 1)) {
 			if (!data->ended) {
-				al_play_sample_instance(data->tada);
+				PlaySoundEffect(game, data->tada);
 			}
 			data->ended = true;
 		}
@@ -508,33 +612,50 @@ static void PerformSleeping(struct Game* game, struct GamestateResources* data)
 	data->cutscene = true;
 	//TM_CleanQueue(data->timeline);
 	//TM_CleanBackgroundQueue(data->timeline);
-	TM_AddAction(data->timeline, ScrollCamToBottom, NULL);
-	TM_AddAction(data->timeline, WakeUp, NULL);
+	AddProfiledAction(data->profiler, ScrollCamToBottom, NULL, "ScrollCamToBottom");
+	AddProfiledAction(data->profiler, WakeUp, NULL, "WakeUp");
 	TM_AddDelay(data->timeline, 1000);
-	TM_AddAction(data->timeline, WaitForGeeseToSettle, NULL);
+	AddProfiledAction(data->profiler, WaitForGeeseToSettle, NULL, "WaitForGeeseToSettle");
 
 	if (!data->ended) {
 		TM_AddDelay(data->timeline, 500);
-		TM_AddQueuedBackgroundAction(data->timeline, HideMenu, NULL, 500);
-		TM_AddAction(data->timeline, Snort, NULL);
+		AddProfiledQueuedBackgroundAction(data->profiler, HideMenu, NULL, 500, "HideMenu");
+		AddProfiledAction(data->profiler, Snort, NULL, "Snort");
 		//TM_AddDelay(data->timeline, 2000);
-		TM_AddAction(data->timeline, MoveDreamsUp, NULL);
+		AddProfiledAction(data->profiler, MoveDreamsUp, NULL, "MoveDreamsUp");
 		TM_AddDelay(data->timeline, 500);
 
 		if (!data->started) {
-			TM_AddAction(data->timeline, StartGame, NULL);
+			AddProfiledAction(data->profiler, StartGame, NULL, "StartGame");
 		} else {
-			TM_AddAction(data->timeline, StartTurn, NULL);
+			AddProfiledAction(data->profiler, StartTurn, NULL, "StartTurn");
 		}
 	} else {
-		TM_AddAction(data->timeline, DoSleeping, NULL);
+		AddProfiledAction(data->profiler, DoSleeping, NULL, "DoSleeping");
 	}
 }
 
+static bool WaitingForInput(struct GamestateResources* data);
+
 void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double delta) {
 	// Here you should do all your game logic as if <delta> seconds have passed.
 	//data->ended = true;
+	UpdateTweens(data->dreamTweens, delta);
 	TM_Process(data->timeline, delta);
+	SampleTimeline(data->profiler);
+
+	// every dream on the board keeps its sheet from getting evicted
+	for (int i = 0; i < COLS * ROWS; i++) {
+		if (data->board[i].dreamy) {
+			RequestSheet(data->dreamSheets, data->board[i].dream.content->spritesheet->name);
+		}
+	}
+	UpdateSheetStreamer(data->dreamSheets, delta);
+
+	if (WaitingForInput(data) && !data->cameraMove) {
+		// only the idle bobbing is left on the screen
+		AllowIdle(game);
+	}
 
 	if (data->cameraMove) {
 		UpdateTween(&data->camera, delta);
@@ -560,18 +681,248 @@ void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double
 	AnimateCharacter(game, data->layers.fg, delta, 1.0);
 }
 
+static void SetupCells(struct GamestateResources* data) {
+	// Cell geometry depends only on the board layout, so it's computed once.
+	for (int j = 0; j < ROWS; j++) {
+		for (int i = 0; i < COLS; i++) {
+			struct Cell* cell = &data->cells[j * (int)COLS + i];
+			cell->num = j * (int)COLS + i;
+			if (j % 2) {
+				cell->num = j * (int)COLS + ((int)COLS - i) - 1;
+			}
+			cell->x = (i + 1.5) * 1920 / (COLS + 2) + 5;
+			cell->y = (j + 1.5) * 2160 / (ROWS + 2) + 3;
+			cell->bob = (0.5 + (0.1 * cell->num)) * 0.25;
+		}
+	}
+}
+
+static int AddCloudQuad(ALLEGRO_VERTEX* v, ALLEGRO_BITMAP* bitmap, float x, float y, float scale, ALLEGRO_COLOR color) {
+	float u = al_get_bitmap_x(bitmap), t = al_get_bitmap_y(bitmap);
+	float w = al_get_bitmap_width(bitmap), h = al_get_bitmap_height(bitmap);
+	float x1 = x - w * scale / 2.0, y1 = y - h * scale / 2.0;
+	float x2 = x + w * scale / 2.0, y2 = y + h * scale / 2.0;
+
+	v[0] = (ALLEGRO_VERTEX){.x = x1, .y = y1, .u = u, .v = t, .color = color};
+	v[1] = (ALLEGRO_VERTEX){.x = x2, .y = y1, .u = u + w, .v = t, .color = color};
+	v[2] = (ALLEGRO_VERTEX){.x = x2, .y = y2, .u = u + w, .v = t + h, .color = color};
+	v[3] = v[0];
+	v[4] = v[2];
+	v[5] = (ALLEGRO_VERTEX){.x = x1, .y = y2, .u = u, .v = t + h, .color = color};
+	return 6;
+}
+
+static void DrawClouds(struct Game* game, struct GamestateResources* data) {
+	// All cloud variants live on a single sheet, so the whole grid goes out in one draw call.
+	// Dream clouds are appended after the regular ones, so they always end up on top.
+	double time = al_get_time();
+	int highlightFrame = floor(fmod(time * 3, 3));
+	int n = 0;
+
+	if (!data->showMenu) {
+		for (int c = 0; c < COLS * (ROWS - 1); c++) {
+			struct Cell* cell = &data->cells[c];
+
+			float highlighted = 0.0;
+			if (data->active) {
+				if (data->currentPlayer->position == cell->num) {
+					highlighted = 1.0;
+				}
+				if (data->currentPlayer->selected == cell->num) {
+					highlighted = 0.75;
+				}
+			}
+
+			int frame = highlighted ? highlightFrame : (cell->num % 3);
+			float s = sin(time * cell->bob) * 10;
+
+			n += AddCloudQuad(&data->cloudVertices[n], data->cloud[frame], cell->x, cell->y + s, 0.666,
+				al_premul_rgba(255, 255, 255, 96 + highlighted * (255 - 96)));
+		}
+	}
+
+	for (int c = 0; c < COLS * ROWS; c++) {
+		struct Cell* cell = &data->cells[c];
+		if (!data->board[cell->num].dreamy) {
+			continue;
+		}
+		struct Dream* dream = &data->board[cell->num].dream;
+		cell->dreamFrame = floor(fmod(time * 3 + cell->num, 3));
+		cell->dreamY = cell->y - GetBatchTweenValue(data->dreamTweens, DisplacementTween(cell->num)) * 2160 / (ROWS + 2);
+		cell->dreamScale = 0.555 * GetBatchTweenValue(data->dreamTweens, SizeTween(cell->num));
+
+		n += AddCloudQuad(&data->cloudVertices[n], dream->good ? data->goodcloud[cell->dreamFrame] : data->badcloud[cell->dreamFrame],
+			cell->x, cell->dreamY, cell->dreamScale, al_map_rgb(255, 255, 255));
+	}
+
+	if (n) {
+		al_draw_prim(data->cloudVertices, NULL, data->clouds, 0, n, ALLEGRO_PRIM_TRIANGLE_LIST);
+	}
+}
+
+static ALLEGRO_BITMAP* CreateCloudSheet(struct Game* game, struct GamestateResources* data) {
+	// Gathers all cloud variants on one bitmap and turns them into sub-bitmaps of it.
+	ALLEGRO_BITMAP** variants[] = {data->cloud, data->badcloud, data->goodcloud};
+	int w = al_get_bitmap_width(data->cloud[0]) + 2, h = al_get_bitmap_height(data->cloud[0]) + 2;
+	ALLEGRO_BITMAP* sheet = al_create_bitmap(w * 3, h * 3);
+	ALLEGRO_BITMAP* target = al_get_target_bitmap();
+
+	al_set_target_bitmap(sheet);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	for (int j = 0; j < 3; j++) {
+		for (int i = 0; i < 3; i++) {
+			ALLEGRO_BITMAP* bitmap = variants[j][i];
+			al_draw_bitmap(bitmap, i * w + 1, j * h + 1, 0);
+			variants[j][i] = al_create_sub_bitmap(sheet, i * w + 1, j * h + 1, al_get_bitmap_width(bitmap), al_get_bitmap_height(bitmap));
+			ReleaseBitmap(game, bitmap);
+		}
+	}
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+	al_set_target_bitmap(target);
+	return sheet;
+}
+
+static void GetTextureRect(ALLEGRO_BITMAP* bitmap, float rect[4]) {
+	// Texture coordinates of the top-left and bottom-right corners of a (sub-)bitmap, as seen by
+	// the shader. Allegro keeps GL textures upside down, so the top edge has the larger V.
+	ALLEGRO_BITMAP* parent = al_is_sub_bitmap(bitmap) ? al_get_parent_bitmap(bitmap) : bitmap;
+	int tw, th;
+	al_get_opengl_texture_size(parent, &tw, &th);
+	float x = al_is_sub_bitmap(bitmap) ? al_get_bitmap_x(bitmap) : 0;
+	float y = al_is_sub_bitmap(bitmap) ? al_get_bitmap_y(bitmap) : 0;
+	float h = al_get_bitmap_height(parent);
+	rect[0] = x / tw;
+	rect[1] = (h - y) / th;
+	rect[2] = (x + al_get_bitmap_width(bitmap)) / tw;
+	rect[3] = (h - y - al_get_bitmap_height(bitmap)) / th;
+}
+
+static void DrawDreamsWithShader(struct Game* game, struct GamestateResources* data) {
+	// Draws every dream cloud once, with its dream multiplied in by the shader.
+	al_use_shader(data->dreamShader);
+	for (int c = 0; c < COLS * ROWS; c++) {
+		struct Cell* cell = &data->cells[c];
+		if (!data->board[cell->num].dreamy) {
+			continue;
+		}
+		struct Dream* dream = &data->board[cell->num].dream;
+		if (!IsSheetResident(data->dreamSheets, dream->content->spritesheet->name)) {
+			continue; // still streaming in; the plain cloud is already there
+		}
+		ALLEGRO_BITMAP* cloud = dream->good ? data->goodcloud[cell->dreamFrame] : data->badcloud[cell->dreamFrame];
+		ALLEGRO_BITMAP* frame = dream->content->spritesheet->frames[dream->content->pos].bitmap;
+
+		float cloudRect[4], dreamRect[4];
+		GetTextureRect(cloud, cloudRect);
+		GetTextureRect(frame, dreamRect);
+		float scale[2] = {al_get_bitmap_width(cloud) / (float)al_get_bitmap_width(frame),
+			al_get_bitmap_height(cloud) / (float)al_get_bitmap_height(frame)};
+
+		al_set_shader_sampler("dream_tex", frame, 1);
+		al_set_shader_float_vector("cloud_rect", 4, cloudRect, 1);
+		al_set_shader_float_vector("dream_rect", 4, dreamRect, 1);
+		al_set_shader_float_vector("dream_scale", 2, scale, 1);
+		DrawCenteredScaled(cloud, cell->x, cell->dreamY, cell->dreamScale, cell->dreamScale, 0);
+	}
+	al_use_shader(NULL);
+}
+
+static void DrawDreamsWithFramebuffer(struct Game* game, struct GamestateResources* data, ALLEGRO_TRANSFORM* t, ALLEGRO_TRANSFORM* transform, ALLEGRO_TRANSFORM* orig) {
+	// Fallback for when shaders aren't available: fakes the multiplication with blenders in an offscreen buffer.
+	al_set_target_bitmap(data->fb);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_use_transform(t);
+	for (int c = 0; c < COLS * ROWS; c++) {
+		struct Cell* cell = &data->cells[c];
+		if (data->board[cell->num].dreamy) {
+			struct Dream* dream = &data->board[cell->num].dream;
+			ALLEGRO_BITMAP* bitmap = dream->good ? data->goodcloud[cell->dreamFrame] : data->badcloud[cell->dreamFrame];
+			al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+			DrawCenteredScaled(bitmap, cell->x, cell->dreamY, cell->dreamScale, cell->dreamScale, 0);
+			if (!IsSheetResident(data->dreamSheets, dream->content->spritesheet->name)) {
+				continue;
+			}
+
+			al_set_blender(ALLEGRO_ADD, ALLEGRO_DEST_COLOR, ALLEGRO_SRC_COLOR);
+			//	ALLEGRO_ADD, ALLEGRO_DEST_COLOR, ALLEGRO_ZERO);
+
+			SetCharacterPosition(game, dream->content, cell->x, cell->dreamY, 0);
+			dream->content->scaleX = cell->dreamScale;
+			dream->content->scaleY = dream->content->scaleX;
+			DrawCharacter(game, dream->content);
+			DrawCharacter(game, dream->content);
+			al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
+		}
+	}
+	SetFramebufferAsTarget(game);
+
+	al_use_transform(orig);
+	al_draw_bitmap(data->fb, 0, 0, 0);
+	al_use_transform(transform);
+}
+
+static ALLEGRO_SHADER* CreateDreamShader(struct Game* game) {
+	if (!strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "shaders", "1"), NULL, 10)) {
+		return NULL;
+	}
+	ALLEGRO_SHADER* shader = al_create_shader(ALLEGRO_SHADER_GLSL);
+	if (!shader) {
+		PrintConsole(game, "Shaders not available, compositing dreams in a framebuffer.");
+		return NULL;
+	}
+	if (!al_attach_shader_source(shader, ALLEGRO_VERTEX_SHADER, al_get_default_shader_source(ALLEGRO_SHADER_GLSL, ALLEGRO_VERTEX_SHADER)) ||
+		!al_attach_shader_source(shader, ALLEGRO_PIXEL_SHADER, DreamPixelShader) ||
+		!al_build_shader(shader)) {
+		PrintConsole(game, "Dream shader failed to build, compositing dreams in a framebuffer: %s", al_get_shader_log(shader));
+		al_destroy_shader(shader);
+		return NULL;
+	}
+	return shader;
+}
+
+static bool UpdateBackdrop(struct Game* game, struct GamestateResources* data, float scroll) {
+	// bg and ground only move with the camera, so they're flattened into a single screen-sized layer
+	// that gets redrawn only when the camera moves. The water is animated and goes between the sky
+	// and bg, so it can't be a part of it.
+	// While the camera moves (or bobs on the title screen) the layer would be redrawn every frame,
+	// which costs more than drawing bg and ground directly; returns whether it's worth using.
+	bool still = !data->initial && !data->cameraMove && scroll == data->lastScroll;
+	data->lastScroll = scroll;
+	if (!still) {
+		return false;
+	}
+	if (scroll == data->backdropScroll) {
+		return true;
+	}
+	data->backdropScroll = scroll;
+	al_set_target_bitmap(data->backdrop);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_draw_bitmap(data->layers.bg, 0, -300 + scroll * 1320, 0);
+	al_draw_bitmap(data->layers.ground, 0, -1080 + 1080 * scroll * 0.95 + 1662, 0);
+	SetFramebufferAsTarget(game);
+	return true;
+}
+
 void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 	// Draw everything to the screen here.
 
 	float scroll = GetTweenValue(&data->camera);
+	bool backdrop = UpdateBackdrop(game, data, scroll);
 
 	al_clear_to_color(al_map_rgb(255, 255, 255));
 	al_draw_bitmap(data->layers.sky, 0, -(1.0 - scroll) * 100, 0);
 	float water = 300 + 1080 * scroll * 1.05;
-	al_draw_bitmap(data->layers.water, 5624 * Fract(al_get_time() / 92.0), water, 0);
-	al_draw_bitmap(data->layers.water, 5624 * Fract(al_get_time() / 92.0) - 5624, water, 0);
-	al_draw_bitmap(data->layers.bg, 0, -300 + scroll * 1320, 0);
-	al_draw_bitmap(data->layers.ground, 0, -1080 + 1080 * scroll * 0.95 + 1662, 0);
+	if (water < 1080) { // gets scrolled out of the view with the camera at the bottom
+		al_draw_bitmap(data->layers.water, 5624 * Fract(al_get_time() / 92.0), water, 0);
+		al_draw_bitmap(data->layers.water, 5624 * Fract(al_get_time() / 92.0) - 5624, water, 0);
+	}
+	if (backdrop) {
+		al_draw_bitmap(data->backdrop, 0, 0, 0);
+	} else {
+		al_draw_bitmap(data->layers.bg, 0, -300 + scroll * 1320, 0);
+		al_draw_bitmap(data->layers.ground, 0, -1080 + 1080 * scroll * 0.95 + 1662, 0);
+	}
 
 	// TODO: transforms are pretty cumbersome to use and restore; add some utils for them?
 
@@ -608,73 +959,13 @@ void Gamestate_Draw(struct Game* game, struct GamestateResources* data) {
 		DrawCenteredScaled(data->menu, 1920 / 2.0, 1080 * 0.8 + sin(al_get_time()) * 20, 0.5, 0.5, 0);
 	}
 
-	for (int j = 0; j < ROWS; j++) {
-		for (int i = 0; i < COLS; i++) {
-			int num = j * (int)COLS + i;
-			if (j % 2) {
-				num = j * (int)COLS + ((int)COLS - i) - 1;
-			}
-
-			float highlighted = 0.0;
-			if (data->currentPlayer->position == num) {
-				highlighted = 1.0;
-			}
-			if (data->currentPlayer->selected == num) {
-				highlighted = 0.75;
-			}
-			if (!data->active) {
-				highlighted = 0;
-			}
-
-			int frame = highlighted ? (floor(fmod(al_get_time() * 3, 3))) : (num % 3);
-
-			float s = sin(al_get_time() * (0.5 + (0.1 * num)) * 0.25) * 10;
-
-			if (j < ROWS - 1) {
-				if (!data->showMenu) {
-					DrawCenteredTintedScaled(data->cloud[frame], al_premul_rgba(255, 255, 255, 96 + highlighted * (255 - 96)), (i + 1.5) * 1920 / (COLS + 2) + 5, (j + 1.5) * 2160 / (ROWS + 2) + 3 + s, 0.666, 0.666, 0);
-				}
-			}
-
-			if (data->board[num].dreamy) {
-				frame = floor(fmod(al_get_time() * 3 + num, 3));
-				DrawCenteredScaled(data->board[num].dream.good ? data->goodcloud[frame] : data->badcloud[frame], (i + 1.5) * 1920 / (COLS + 2) + 5, (j + 1.5 - GetTweenValue(&data->board[num].dream.displacement)) * 2160 / (ROWS + 2) + 3, 0.555 * GetTweenValue(&data->board[num].dream.size), 0.555 * GetTweenValue(&data->board[num].dream.size), 0);
-			}
-		}
-	}
-
-	al_set_target_bitmap(data->fb);
-	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
-	al_use_transform(&t);
-	for (int j = 0; j < ROWS; j++) {
-		for (int i = 0; i < COLS; i++) {
-			int num = j * (int)COLS + i;
-			if (j % 2) {
-				num = j * (int)COLS + ((int)COLS - i) - 1;
-			}
-
-			if (data->board[num].dreamy) {
-				int frame = floor(fmod(al_get_time() * 3 + num, 3));
-				al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
-				DrawCenteredScaled(data->board[num].dream.good ? data->goodcloud[frame] : data->badcloud[frame], (i + 1.5) * 1920 / (COLS + 2) + 5, (j + 1.5 - GetTweenValue(&data->board[num].dream.displacement)) * 2160 / (ROWS + 2) + 3, 0.555 * GetTweenValue(&data->board[num].dream.size), 0.555 * GetTweenValue(&data->board[num].dream.size), 0);
-
-				al_set_blender(ALLEGRO_ADD, ALLEGRO_DEST_COLOR, ALLEGRO_SRC_COLOR);
-				//	ALLEGRO_ADD, ALLEGRO_DEST_COLOR, ALLEGRO_ZERO);
+	DrawClouds(game, data);
 
-				SetCharacterPosition(game, data->board[num].dream.content, (i + 1.5) * 1920 / (COLS + 2) + 5, (j + 1.5 - GetTweenValue(&data->board[num].dream.displacement)) * 2160 / (ROWS + 2) + 3, 0);
-				data->board[num].dream.content->scaleX = 0.555 * GetTweenValue(&data->board[num].dream.size);
-				data->board[num].dream.content->scaleY = data->board[num].dream.content->scaleX;
-				DrawCharacter(game, data->board[num].dream.content);
-				DrawCharacter(game, data->board[num].dream.content);
-				al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_INVERSE_ALPHA);
-			}
-		}
+	if (data->dreamShader) {
+		DrawDreamsWithShader(game, data);
+	} else {
+		DrawDreamsWithFramebuffer(game, data, &t, &transform, &orig);
 	}
-	SetFramebufferAsTarget(game);
-
-	al_use_transform(&orig);
-	al_draw_bitmap(data->fb, 0, 0, 0);
-	al_use_transform(&transform);
 
 	for (int p = 0; p < 6; p++) {
 		struct Player* player = &data->players[p];
@@ -776,6 +1067,9 @@ void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data,
 		if (ev->keyboard.keycode == ALLEGRO_KEY_S && game->config.debug) {
 			DoStartGame(game, data);
 		}
+		if (ev->keyboard.keycode == ALLEGRO_KEY_P && game->config.debug) {
+			PrintTimelineProfile(game, data->profiler);
+		}
 		if (ev->keyboard.keycode == ALLEGRO_KEY_BACKSPACE && game->config.debug) {
 			data->cameraMove = true;
 			data->camera = Tween(game, 0.0, 1.0, TWEEN_STYLE_QUARTIC_IN_OUT, 3.0);
@@ -807,80 +1101,100 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	// NOTE: There's no OpenGL context available here. If you want to prerender something,
 	// create VBOs, etc. do it in Gamestate_PostLoad.
 
-	struct GamestateResources* data = calloc(1, sizeof(struct GamestateResources));
+	// Everything loaded here and in PostLoad gets tracked by the arena, which releases it
+	// all on unload; the struct itself is allocated from it too.
+	struct Arena* arena = CreateArena(game, "board");
+	struct GamestateResources* data = ArenaAlloc(arena, sizeof(struct GamestateResources));
+	data->arena = arena;
+	WaitForPrefetch(game); // whatever got decoded during the intros is a cache hit below
 	progress(game); // report that we progressed with the loading, so the engine can move a progress bar
 
-	data->layers.bg = al_load_bitmap(GetDataFilePath(game, "bg.png"));
-	progress(game);
-	data->layers.fg = CreateCharacter(game, "fg");
-	RegisterSpritesheet(game, data->layers.fg, "shine");
-	RegisterSpritesheet(game, data->layers.fg, "stand");
-	LoadSpritesheets(game, data->layers.fg, progress);
-	data->layers.ground = al_load_bitmap(GetDataFilePath(game, "trawka.png"));
-	progress(game);
-	data->layers.sky = al_load_bitmap(GetDataFilePath(game, "sky.png"));
-	progress(game);
-	data->layers.water = al_load_bitmap(GetDataFilePath(game, "water.png"));
-	progress(game);
-	data->logo = al_load_bitmap(GetDataFilePath(game, "logo.png"));
-	progress(game);
-	data->menu = al_load_bitmap(GetDataFilePath(game, "menu.png"));
-	progress(game);
+	// Images get decoded on a pool of worker threads, see loader.c. Every queued
+	// item reports its progress steps once decoded, so the count stays the same.
+	struct AssetLoader* loader = CreateAssetLoader(game);
+
+	// Paths come from assets.c, which is also where the prefetch in main.c takes them from.
+	QueueBitmap(loader, &data->layers.bg, GetBoardImagePath(game, BOARD_BG, 0), 1);
+	data->layers.fg = CreateBoardCharacter(game, BOARD_FG, 0);
+	struct Atlas* fgAtlas = QueueCharacterSpritesheets(game, loader, data->layers.fg, progress);
+	QueueBitmap(loader, &data->layers.ground, GetBoardImagePath(game, BOARD_GROUND, 0), 1);
+	QueueBitmap(loader, &data->layers.sky, GetBoardImagePath(game, BOARD_SKY, 0), 1);
+	QueueBitmap(loader, &data->layers.water, GetBoardImagePath(game, BOARD_WATER, 0), 1);
+	QueueBitmap(loader, &data->logo, GetBoardImagePath(game, BOARD_LOGO, 0), 1);
+	QueueBitmap(loader, &data->menu, GetBoardImagePath(game, BOARD_MENU, 0), 1);
+	TrackCachedBitmap(arena, &data->layers.bg);
+	TrackCharacter(arena, &data->layers.fg);
+	TrackCachedBitmap(arena, &data->layers.ground);
+	TrackCachedBitmap(arena, &data->layers.sky);
+	TrackCachedBitmap(arena, &data->layers.water);
+	TrackCachedBitmap(arena, &data->logo);
+	TrackCachedBitmap(arena, &data->menu);
 
 	for (int i = 0; i < 6; i++) {
 		data->players[i].id = i;
-		data->players[i].standby = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "pliszka_standbyX.png", 'X', i + 1)));
-		progress(game);
-		data->players[i].moving = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "pliszka_w_locieX.png", 'X', i + 1)));
-		progress(game);
-		data->players[i].pawn = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "czapeczka_kolorX.png", 'X', i + 1)));
-		progress(game);
+		QueueBitmap(loader, &data->players[i].standby, GetBoardImagePath(game, BOARD_STANDBY, i), 1);
+		QueueBitmap(loader, &data->players[i].moving, GetBoardImagePath(game, BOARD_MOVING, i), 1);
+		QueueBitmap(loader, &data->players[i].pawn, GetBoardImagePath(game, BOARD_PAWN, i), 1);
+		TrackCachedBitmap(arena, &data->players[i].standby);
+		TrackCachedBitmap(arena, &data->players[i].moving);
+		TrackCachedBitmap(arena, &data->players[i].pawn);
 	}
 
+	// the clouds get tracked in PostLoad, once they're on their sheet
+
 	for (int i = 0; i < 3; i++) {
-		data->cloud[i] = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "chmurka_z_cieniemX.png", 'X', i + 1)));
-		progress(game);
-		data->badcloud[i] = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "chmurka_czerwonaX.png", 'X', i + 1)));
-		progress(game);
-		data->goodcloud[i] = al_load_bitmap(GetDataFilePath(game, PunchNumber(game, "chmurka_zielonaX.png", 'X', i + 1)));
-		progress(game);
+		QueueBitmap(loader, &data->cloud[i], GetBoardImagePath(game, BOARD_CLOUD, i), 1);
+		QueueBitmap(loader, &data->badcloud[i], GetBoardImagePath(game, BOARD_BADCLOUD, i), 1);
+		QueueBitmap(loader, &data->goodcloud[i], GetBoardImagePath(game, BOARD_GOODCLOUD, i), 1);
 	}
 
+	struct Atlas* geeseAtlas[3];
 	for (int i = 0; i < 3; i++) {
-		data->gooses[i].character = CreateCharacter(game, PunchNumber(game, "gesX", 'X', i + 1));
-		RegisterSpritesheet(game, data->gooses[i].character, "quack");
-		RegisterSpritesheet(game, data->gooses[i].character, "sleep");
-		RegisterSpritesheet(game, data->gooses[i].character, "stand");
-		RegisterSpritesheet(game, data->gooses[i].character, "wakeup");
-		RegisterSpritesheet(game, data->gooses[i].character, "walk");
-		RegisterSpritesheet(game, data->gooses[i].character, "buch");
-		LoadSpritesheets(game, data->gooses[i].character, progress);
-	}
-
-	data->superdream = CreateCharacter(game, "dream");
-	RegisterSpritesheet(game, data->superdream, "sen1");
-	RegisterSpritesheet(game, data->superdream, "sen2");
-	RegisterSpritesheet(game, data->superdream, "sen3");
-	RegisterSpritesheet(game, data->superdream, "sen4");
-	RegisterSpritesheet(game, data->superdream, "sen5");
-	LoadSpritesheets(game, data->superdream, progress);
+		data->gooses[i].character = CreateBoardCharacter(game, BOARD_GOOSE, i);
+		geeseAtlas[i] = QueueCharacterSpritesheets(game, loader, data->gooses[i].character, progress);
+		TrackCharacter(arena, &data->gooses[i].character);
+	}
+
+	RunAssetLoader(loader, progress);
+	data->loader = loader;
+
+	FinishCharacterSpritesheets(game, fgAtlas, data->layers.fg);
+	for (int i = 0; i < 3; i++) {
+		FinishCharacterSpritesheets(game, geeseAtlas[i], data->gooses[i].character);
+	}
+
+	// The dream pool gets filled here rather than in PostLoad, so registering its spritesheets
+	// happens on the loading thread and is part of the progress count (one step per row).
+	// Their frames are only loaded (or streamed in) later, see PostLoad.
+	for (int i = 0; i < COLS * ROWS; i++) {
+		data->dreams.all[i] = CreateDream(game);
+		TrackCharacter(arena, &data->dreams.all[i]);
+		ReturnDream(data, data->dreams.all[i]);
+		if (i % (int)COLS == COLS - 1) {
+			progress(game);
+		}
+	}
+
+	SetupCells(data);
 
 	data->timeline = TM_Init(game, data, "rounds");
+	data->profiler = CreateTimelineProfiler(data->timeline, ROUNDS_ACTION_POOL);
+	TrackTimelineProfiler(arena, &data->profiler); // has to outlive the timeline
+	TrackTimeline(arena, &data->timeline);
+	data->dreamTweens = CreateTweenBatch(2 * COLS * ROWS, strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "tween_lut", "0"), NULL, 10));
+	TrackTweenBatch(arena, &data->dreamTweens);
 
-	data->music = al_load_audio_stream(GetDataFilePath(game, "music.ogg"), 4, 1024);
+	data->music = OpenAudioStream(game, "music.ogg", 4, 1024);
 	al_set_audio_stream_playing(data->music, false);
 	al_attach_audio_stream_to_mixer(data->music, game->audio.music);
 	al_set_audio_stream_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
+	TrackAudioStream(arena, &data->music);
 
-	data->ding_sample = al_load_sample(GetDataFilePath(game, "ding.ogg"));
-	data->ding = al_create_sample_instance(data->ding_sample);
-	al_attach_sample_instance_to_mixer(data->ding, game->audio.fx);
-	al_set_sample_instance_playmode(data->ding, ALLEGRO_PLAYMODE_ONCE);
-
-	data->tada_sample = al_load_sample(GetDataFilePath(game, "tada.ogg"));
-	data->tada = al_create_sample_instance(data->tada_sample);
-	al_attach_sample_instance_to_mixer(data->tada, game->audio.fx);
-	al_set_sample_instance_playmode(data->tada, ALLEGRO_PLAYMODE_ONCE);
+	// quick moves can overlap their dings
+	data->ding = LoadSoundEffect(game, "ding.ogg", 3);
+	data->tada = LoadSoundEffect(game, "tada.ogg", 1);
+	TrackSoundEffect(arena, &data->ding);
+	TrackSoundEffect(arena, &data->tada);
 
 	return data;
 }
@@ -888,8 +1202,112 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_audio_stream(data->music);
-	free(data);
+	PrintCacheStats(game);
+	if (game->config.debug) {
+		PrintTimelineProfile(game, data->profiler);
+	}
+	DestroyArena(game, data->arena); // everything from Load and PostLoad, data included
+}
+
+#define HEADLESS_DELTA (1.0 / 60.0)
+#define HEADLESS_LIMIT (24 * 60 * 60.0) // simulated seconds; a game that doesn't end by then is stuck
+
+static int LoadScript(struct Game* game, const char* filename, int** keys) {
+	// One key per whitespace-separated token: SPACE, LEFT or RIGHT. Unknown tokens are skipped.
+	int count = 0, capacity = 0;
+	*keys = NULL;
+	FILE* file = filename ? fopen(filename, "r") : NULL;
+	if (filename && !file) {
+		PrintConsole(game, "Could not open input script %s!", filename);
+	}
+	char token[16];
+	while (file && fscanf(file, "%15s", token) == 1) {
+		int key = 0;
+		if (strcmp(token, "SPACE") == 0) {
+			key = ALLEGRO_KEY_SPACE;
+		} else if (strcmp(token, "LEFT") == 0) {
+			key = ALLEGRO_KEY_LEFT;
+		} else if (strcmp(token, "RIGHT") == 0) {
+			key = ALLEGRO_KEY_RIGHT;
+		} else {
+			PrintConsole(game, "Unknown key %s in input script, skipping.", token);
+			continue;
+		}
+		if (count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			*keys = realloc(*keys, sizeof(int) * capacity);
+		}
+		(*keys)[count++] = key;
+	}
+	if (file) {
+		fclose(file);
+	}
+	if (!count) {
+		// nothing usable; just keep moving forward
+		*keys = realloc(*keys, sizeof(int));
+		(*keys)[count++] = ALLEGRO_KEY_SPACE;
+	}
+	return count;
+}
+
+static bool WaitingForInput(struct GamestateResources* data) {
+	if (data->timeline->queue) {
+		return false;
+	}
+	if (!data->started) {
+		return !data->cutscene;
+	}
+	return data->active;
+}
+
+static void PrintBoard(struct GamestateResources* data) {
+	// top row first, as seen on the screen
+	for (int j = ROWS - 1; j >= 0; j--) {
+		for (int i = 0; i < COLS; i++) {
+			struct Field* field = &data->board[data->cells[j * (int)COLS + i].num];
+			if (field->dreamy) {
+				printf(" %c%d", field->dream.good ? '+' : '-', field->dream.id);
+			} else {
+				printf("  .");
+			}
+		}
+		printf("\n");
+	}
+	for (int i = 0; i < 6; i++) {
+		if (data->players[i].active) {
+			printf("player %d: field %d\n", i + 1, data->players[i].position);
+		}
+	}
+}
+
+static void RunHeadless(struct Game* game, struct GamestateResources* data) {
+	// Drives the board with scripted input and a fixed timestep, without ever returning
+	// to the engine to draw. The script is replayed from the start whenever it runs out.
+	int* keys;
+	int count = LoadScript(game, game->data->script, &keys);
+	int next = 0;
+	double simulated = 0.0, start = al_get_time();
+
+	while (!data->ended && simulated < HEADLESS_LIMIT) {
+		if (WaitingForInput(data)) {
+			ALLEGRO_EVENT ev = {.type = ALLEGRO_EVENT_KEY_DOWN};
+			ev.keyboard.keycode = keys[next];
+			next = (next + 1) % count;
+			Gamestate_ProcessEvent(game, data, &ev);
+		}
+		Gamestate_Logic(game, data, HEADLESS_DELTA);
+		simulated += HEADLESS_DELTA;
+	}
+
+	double elapsed = al_get_time() - start;
+	if (!data->ended) {
+		printf("headless: no winner after %.0f simulated seconds\n", simulated);
+	}
+	printf("headless: %d turns in %.0f simulated seconds, %.3f s real time (%.0f turns/s)\n", data->turns, simulated, elapsed, elapsed > 0 ? data->turns / elapsed : 0.0);
+	PrintBoard(data);
+	free(keys);
+
+	UnloadCurrentGamestate(game); // nothing else is running, so the engine will quit
 }
 
 void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
@@ -902,12 +1320,14 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	data->started = false;
 	data->initial = true;
 
+	SeedRandom(&data->rng, game->data->seed + data->games++);
+
 	al_set_audio_stream_playing(data->music, true);
 
 	for (int i = 0; i < 3; i++) {
 		SelectSpritesheet(game, data->gooses[i].character, "sleep");
 		SetCharacterPosition(game, data->gooses[i].character, 300, 1900, 0);
-		data->gooses[i].pos = rand() % (int)COLS;
+		data->gooses[i].pos = RandomInt(&data->rng, (int)COLS);
 		data->gooses[i].desired = data->gooses[i].pos;
 		data->gooses[i].position = Tween(game, data->gooses[i].pos, data->gooses[i].pos, TWEEN_STYLE_LINEAR, 0.0);
 	}
@@ -927,6 +1347,11 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	for (int i = 4; i < 6; i++) {
 		data->players[i].active = false;
 	}
+	data->turns = 0;
+
+	if (game->data->headless) {
+		RunHeadless(game, data);
+	}
 }
 
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
@@ -939,7 +1364,47 @@ void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
 void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
 	// This is called in the main thread after Gamestate_Load has ended.
 	// Use it to prerender bitmaps, create VBOs, etc.
-	data->fb = CreateNotPreservedBitmap(1920, 1080);
+	UploadAssets(data->loader);
+	data->loader = NULL;
+	FinishPrefetch(game); // the board holds its own references by now
+
+	data->dreamShader = CreateDreamShader(game);
+	if (!data->dreamShader) {
+		data->fb = CreateNotPreservedBitmap(1920, 1080);
+	}
+	data->backdrop = CreateNotPreservedBitmap(1920, 1080);
+	data->backdropScroll = NAN;
+	data->lastScroll = NAN;
+	TrackShader(data->arena, &data->dreamShader);
+	TrackBitmap(data->arena, &data->fb);
+	TrackBitmap(data->arena, &data->backdrop);
+
+	data->clouds = CreateCloudSheet(game, data);
+	TrackBitmap(data->arena, &data->clouds);
+	for (int i = 0; i < 3; i++) {
+		// sub-bitmaps, released before the sheet
+		TrackBitmap(data->arena, &data->cloud[i]);
+		TrackBitmap(data->arena, &data->badcloud[i]);
+		TrackBitmap(data->arena, &data->goodcloud[i]);
+	}
+
+	// Dream sheets get streamed in once rolled (see WakeUp) and evicted after [WakeyWakey]
+	// dream_evict_after seconds without a dream using them; stream_dreams=0 loads them all here.
+	if (strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "stream_dreams", "1"), NULL, 10)) {
+		data->dreamSheets = CreateSheetStreamer(game, data->dreams.all[0],
+			strtod(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "dream_evict_after", "60"), NULL));
+		TrackSheetStreamer(data->arena, &data->dreamSheets); // takes its frames back before the characters go
+	}
+	if (data->dreamSheets) {
+		for (int i = 0; i < COLS * ROWS; i++) {
+			AddStreamedCharacter(data->dreamSheets, data->dreams.all[i]);
+		}
+	} else {
+		// the atlas is read once for all of them, and the frames are cache hits after the first one
+		LoadSharedSpritesheets(game, data->dreams.all, COLS * ROWS);
+	}
+
+	PublishArena(game, data->arena); // for the residency report, now that everything is tracked
 }
 
 void Gamestate_Pause(struct Game* game, struct GamestateResources* data) {
@@ -954,5 +1419,14 @@ void Gamestate_Resume(struct Game* game, struct GamestateResources* data) {
 void Gamestate_Reload(struct Game* game, struct GamestateResources* data) {
 	// Called when the display gets lost and not preserved bitmaps need to be recreated.
 	// Unless you want to support mobile platforms, you should be able to ignore it.
-	data->fb = CreateNotPreservedBitmap(1920, 1080);
+	// The old buffers are still tracked by the arena through the same fields, so only
+	// their objects need replacing.
+	if (!data->dreamShader) {
+		al_destroy_bitmap(data->fb);
+		data->fb = CreateNotPreservedBitmap(1920, 1080);
+	}
+	al_destroy_bitmap(data->backdrop);
+	data->backdrop = CreateNotPreservedBitmap(1920, 1080);
+	data->backdropScroll = NAN;
+	data->lastScroll = NAN;
 }
@@ -25,15 +25,20 @@
 #define NEXT_GAMESTATE "board"
 #define SKIP_GAMESTATE NEXT_GAMESTATE
 
+// the intro queues six profiled actions at once, and nothing else
+#define MAIN_ACTION_POOL 8
+
 struct GamestateResources {
 	ALLEGRO_FONT* font;
-	ALLEGRO_SAMPLE *sample, *kbd_sample, *key_sample;
-	ALLEGRO_SAMPLE_INSTANCE *sound, *kbd, *key;
+	ALLEGRO_SAMPLE_INSTANCE *sound, *kbd, *key; // from the sound registry
 	ALLEGRO_BITMAP *bitmap, *checkerboard, *pixelator;
 	int pos, fade, tick, tan;
+	double typeDelay;
 	char text[255];
 	bool underscore, fadeout;
 	struct Timeline* timeline;
+	struct TimelineProfiler* profiler;
+	struct Arena* arena;
 };
 
 int Gamestate_ProgressCount = 5;
@@ -72,25 +77,31 @@ static TM_ACTION(End) {
 
 static TM_ACTION(Play) {
 	TM_RunningOnly;
-	al_play_sample_instance(TM_Arg(0));
+	PlaySampleInstance(game, TM_Arg(0));
 	return true;
 }
 
 static TM_ACTION(Type) {
+	// stays alive for the whole text instead of adding itself again after every character
 	TM_RunningOnly;
+	data->typeDelay -= action->delta;
+	if (data->typeDelay > 0) {
+		return false;
+	}
 	strncpy(data->text, text, data->pos++);
 	data->text[data->pos] = 0;
 	if (strcmp(data->text, text) != 0) {
-		TM_AddBackgroundAction(data->timeline, Type, NULL, 60 + rand() % 60);
-	} else {
-		al_stop_sample_instance(data->kbd);
+		data->typeDelay = (60 + rand() % 60) / 1000.0;
+		return false;
 	}
+	StopSampleInstance(game, data->kbd);
 	return true;
 }
 //==================================Timeline manager actions END
 
 void Gamestate_Logic(struct Game* game, struct GamestateResources* data, double delta) {
 	TM_Process(data->timeline, delta);
+	SampleTimeline(data->profiler);
 	data->tick++;
 	if (data->tick == 30) {
 		data->underscore = !data->underscore;
@@ -142,40 +153,46 @@ void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
 	data->fade = 0;
 	data->tan = 64;
 	data->tick = 0;
+	data->typeDelay = 0;
 	data->fadeout = false;
 	data->underscore = true;
 	strncpy(data->text, "#", 255);
 	TM_AddDelay(data->timeline, 300);
-	TM_AddQueuedBackgroundAction(data->timeline, FadeIn, NULL, 0);
+	AddProfiledQueuedBackgroundAction(data->profiler, FadeIn, NULL, 0, "FadeIn");
 	TM_AddDelay(data->timeline, 1500);
-	TM_AddNamedAction(data->timeline, Play, TM_Args(data->kbd), "PlayKbd");
-	TM_AddQueuedBackgroundAction(data->timeline, Type, NULL, 0);
+	AddProfiledAction(data->profiler, Play, data->kbd, "PlayKbd");
+	AddProfiledQueuedBackgroundAction(data->profiler, Type, NULL, 0, "Type");
 	TM_AddDelay(data->timeline, 3200);
-	TM_AddNamedAction(data->timeline, Play, TM_Args(data->key), "PlayKey");
+	AddProfiledAction(data->profiler, Play, data->key, "PlayKey");
 	TM_AddDelay(data->timeline, 50);
-	TM_AddAction(data->timeline, FadeOut, NULL);
+	AddProfiledAction(data->profiler, FadeOut, NULL, "FadeOut");
 	TM_AddDelay(data->timeline, 1000);
-	TM_AddAction(data->timeline, End, NULL);
-	al_play_sample_instance(data->sound);
+	AddProfiledAction(data->profiler, End, NULL, "End");
+	PlaySampleInstance(game, data->sound);
 }
 
 void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data, ALLEGRO_EVENT* ev) {
 	if (((ev->type == ALLEGRO_EVENT_KEY_DOWN) && (ev->keyboard.keycode == ALLEGRO_KEY_ESCAPE)) || (ev->type == ALLEGRO_EVENT_TOUCH_END)) {
-		SwitchCurrentGamestate(game, SKIP_GAMESTATE);
-		if (strcmp(SKIP_GAMESTATE, NEXT_GAMESTATE) != 0) {
-			UnloadGamestate(game, NEXT_GAMESTATE);
-		}
+		SwitchCurrentGamestate(game, SKIP_GAMESTATE); // anything skipped over gets unloaded by its residency policy
 	}
 }
 void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
-	struct GamestateResources* data = malloc(sizeof(struct GamestateResources));
+	struct Arena* arena = CreateArena(game, "dosowisko");
+	struct GamestateResources* data = ArenaAlloc(arena, sizeof(struct GamestateResources));
+	data->arena = arena;
 	int flags = al_get_new_bitmap_flags();
 	al_set_new_bitmap_flags(flags ^ ALLEGRO_MAG_LINEAR);
 
 	data->timeline = TM_Init(game, data, "main");
+	data->profiler = CreateTimelineProfiler(data->timeline, MAIN_ACTION_POOL);
+	TrackTimelineProfiler(arena, &data->profiler);
+	TrackTimeline(arena, &data->timeline);
 	data->bitmap = CreateNotPreservedBitmap(320, 180);
 	data->checkerboard = al_create_bitmap(320, 180);
 	data->pixelator = CreateNotPreservedBitmap(320, 180);
+	TrackBitmap(arena, &data->bitmap);
+	TrackBitmap(arena, &data->checkerboard);
+	TrackBitmap(arena, &data->pixelator);
 
 	al_set_target_bitmap(data->checkerboard);
 	al_lock_bitmap(data->checkerboard, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_WRITEONLY);
@@ -192,24 +209,23 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	al_set_target_backbuffer(game->display);
 	(*progress)(game);
 
-	data->font = al_load_ttf_font(GetDataFilePath(game, "fonts/DejaVuSansMono.ttf"),
+	data->font = LoadDataFont(game, "fonts/DejaVuSansMono.ttf",
 		(int)(180 * 0.1666 / 8) * 8, 0);
+	TrackFont(arena, &data->font);
 	(*progress)(game);
-	data->sample = al_load_sample(GetDataFilePath(game, "dosowisko.flac"));
-	data->sound = al_create_sample_instance(data->sample);
-	al_attach_sample_instance_to_mixer(data->sound, game->audio.music);
+	// decoded in the background (in this order), see sounds.c
+	data->sound = AcquireSampleInstance(game, "dosowisko.flac", game->audio.music);
+	TrackSampleInstance(arena, &data->sound);
 	al_set_sample_instance_playmode(data->sound, ALLEGRO_PLAYMODE_ONCE);
 	(*progress)(game);
 
-	data->kbd_sample = al_load_sample(GetDataFilePath(game, "kbd.flac"));
-	data->kbd = al_create_sample_instance(data->kbd_sample);
-	al_attach_sample_instance_to_mixer(data->kbd, game->audio.fx);
+	data->kbd = AcquireSampleInstance(game, "kbd.flac", game->audio.fx);
+	TrackSampleInstance(arena, &data->kbd);
 	al_set_sample_instance_playmode(data->kbd, ALLEGRO_PLAYMODE_ONCE);
 	(*progress)(game);
 
-	data->key_sample = al_load_sample(GetDataFilePath(game, "key.flac"));
-	data->key = al_create_sample_instance(data->key_sample);
-	al_attach_sample_instance_to_mixer(data->key, game->audio.fx);
+	data->key = AcquireSampleInstance(game, "key.flac", game->audio.fx);
+	TrackSampleInstance(arena, &data->key);
 	al_set_sample_instance_playmode(data->key, ALLEGRO_PLAYMODE_ONCE);
 	(*progress)(game);
 
@@ -218,28 +234,26 @@ void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
 	return data;
 }
 
+void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
+	PublishArena(game, data->arena);
+}
+
 void Gamestate_Stop(struct Game* game, struct GamestateResources* data) {
-	al_stop_sample_instance(data->sound);
-	al_stop_sample_instance(data->kbd);
-	al_stop_sample_instance(data->key);
+	StopSampleInstance(game, data->sound);
+	StopSampleInstance(game, data->kbd);
+	StopSampleInstance(game, data->key);
 }
 
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
-	al_destroy_font(data->font);
-	al_destroy_sample_instance(data->sound);
-	al_destroy_sample(data->sample);
-	al_destroy_sample_instance(data->kbd);
-	al_destroy_sample(data->kbd_sample);
-	al_destroy_sample_instance(data->key);
-	al_destroy_sample(data->key_sample);
-	al_destroy_bitmap(data->bitmap);
-	al_destroy_bitmap(data->checkerboard);
-	al_destroy_bitmap(data->pixelator);
-	TM_Destroy(data->timeline);
-	free(data);
+	if (game->config.debug) {
+		PrintTimelineProfile(game, data->profiler);
+	}
+	DestroyArena(game, data->arena);
 }
 
 void Gamestate_Reload(struct Game* game, struct GamestateResources* data) {
+	al_destroy_bitmap(data->bitmap);
+	al_destroy_bitmap(data->pixelator);
 	data->bitmap = CreateNotPreservedBitmap(320, 180);
 	data->pixelator = CreateNotPreservedBitmap(320, 180);
 }
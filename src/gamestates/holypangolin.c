@@ -26,6 +26,7 @@
 #define SKIP_GAMESTATE "board"
 
 struct GamestateResources {
+	struct Arena* arena;
 	ALLEGRO_BITMAP* bmp;
 	double counter;
 	ALLEGRO_AUDIO_STREAM* monkeys;
@@ -56,22 +57,28 @@ void Gamestate_ProcessEvent(struct Game* game, struct GamestateResources* data,
 }
 
 void* Gamestate_Load(struct Game* game, void (*progress)(struct Game*)) {
-	struct GamestateResources* data = malloc(sizeof(struct GamestateResources));
-	data->bmp = al_load_bitmap(GetDataFilePath(game, "holypangolin.webp"));
+	struct Arena* arena = CreateArena(game, "holypangolin");
+	struct GamestateResources* data = ArenaAlloc(arena, sizeof(struct GamestateResources));
+	data->arena = arena;
+	data->bmp = LoadDataBitmap(game, "holypangolin.webp");
+	TrackBitmap(arena, &data->bmp);
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 
-	data->monkeys = al_load_audio_stream(GetDataFilePath(game, "holypangolin.flac"), 4, 1024);
+	data->monkeys = OpenAudioStream(game, "holypangolin.flac", 4, 1024);
 	al_set_audio_stream_playing(data->monkeys, false);
 	al_attach_audio_stream_to_mixer(data->monkeys, game->audio.fx);
 	al_set_audio_stream_gain(data->monkeys, 0.75);
+	TrackAudioStream(arena, &data->monkeys);
 
 	return data;
 }
 
+void Gamestate_PostLoad(struct Game* game, struct GamestateResources* data) {
+	PublishArena(game, data->arena);
+}
+
 void Gamestate_Unload(struct Game* game, struct GamestateResources* data) {
-	al_destroy_bitmap(data->bmp);
-	al_destroy_audio_stream(data->monkeys);
-	free(data);
+	DestroyArena(game, data->arena);
 }
 
 void Gamestate_Start(struct Game* game, struct GamestateResources* data) {
@@ -0,0 +1,237 @@
+/*! \file loader.c
+ *  \brief Parallel image decoding for gamestate loading.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+struct AssetLoader* CreateAssetLoader(struct Game* game) {
+	struct AssetLoader* loader = calloc(1, sizeof(struct AssetLoader));
+	loader->game = game;
+	loader->flags = al_get_new_bitmap_flags();
+#ifdef LIBSUPERDERPY_SINGLE_THREAD
+	loader->threads = 0;
+#else
+	// 0 means one worker per core
+	loader->threads = strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "loader_threads", "0"), NULL, 10);
+	if (loader->threads <= 0) {
+		loader->threads = al_get_cpu_count();
+	}
+	if (loader->threads <= 0) {
+		loader->threads = 1;
+	}
+#endif
+	return loader;
+}
+
+void QueueBitmap(struct AssetLoader* loader, ALLEGRO_BITMAP** bitmap, const char* filename, int steps) {
+	if (loader->count == loader->capacity) {
+		loader->capacity = loader->capacity ? loader->capacity * 2 : 64;
+		loader->jobs = realloc(loader->jobs, sizeof(struct LoaderJob) * loader->capacity);
+	}
+	struct LoaderJob* job = &loader->jobs[loader->count++];
+	*job = (struct LoaderJob){.name = strdup(filename), .bitmap = bitmap, .steps = steps};
+	*bitmap = LookupBitmap(loader->game, filename);
+	if (*bitmap) {
+		// already resident, nothing to decode; counted right away so waiters don't sleep on it
+		job->done = true;
+		loader->finished++;
+		return;
+	}
+	job->hasTexture = FindTexture(loader->game, filename, &job->texture);
+	job->packed = FindPacked(loader->game, filename);
+	if (!job->packed) {
+		// paths get resolved here, as GetDataFilePath isn't meant to be called from the workers
+		job->path = strdup(GetDataFilePath(loader->game, filename));
+	}
+}
+
+static void Decode(struct AssetLoader* loader, struct LoaderJob* job) {
+	if (job->done) {
+		return;
+	}
+	ALLEGRO_BITMAP* bitmap = job->hasTexture ? LoadTexture(&job->texture) : NULL;
+	if (!bitmap) {
+		bitmap = job->packed ? LoadPackedBitmap(job->packed) : al_load_bitmap(job->path);
+	}
+	*job->bitmap = StoreBitmap(loader->game, job->name, bitmap);
+	if (!*job->bitmap) {
+		PrintConsole(loader->game, "Could not load %s!", job->name);
+	}
+}
+
+static void* Worker(ALLEGRO_THREAD* thread, void* d) {
+	struct AssetLoader* loader = d;
+	// new bitmap flags are thread-local; decode straight into memory, upload happens in PostLoad
+	al_set_new_bitmap_flags((loader->flags & ~(ALLEGRO_VIDEO_BITMAP | ALLEGRO_CONVERT_BITMAP)) | ALLEGRO_MEMORY_BITMAP);
+
+	al_lock_mutex(loader->mutex);
+	while (loader->next < loader->count) {
+		struct LoaderJob* job = &loader->jobs[loader->next++];
+		if (job->done) {
+			continue;
+		}
+		al_unlock_mutex(loader->mutex);
+
+		Decode(loader, job);
+
+		al_lock_mutex(loader->mutex);
+		job->done = true;
+		loader->finished++;
+		al_broadcast_cond(loader->cond);
+	}
+	al_unlock_mutex(loader->mutex);
+	return NULL;
+}
+
+static void Report(struct AssetLoader* loader, struct LoaderJob* job, void (*progress)(struct Game*)) {
+	for (int s = 0; s < job->steps; s++) {
+		if (progress) {
+			progress(loader->game);
+		}
+	}
+	job->reported = true;
+}
+
+static void StartWorkers(struct AssetLoader* loader) {
+	loader->mutex = al_create_mutex();
+	loader->cond = al_create_cond();
+	loader->workerCount = loader->threads < loader->count ? loader->threads : loader->count;
+	loader->workers = calloc(loader->workerCount, sizeof(ALLEGRO_THREAD*));
+	for (int i = 0; i < loader->workerCount; i++) {
+		loader->workers[i] = al_create_thread(Worker, loader);
+		al_start_thread(loader->workers[i]);
+	}
+	loader->running = true;
+}
+
+static void JoinWorkers(struct AssetLoader* loader) {
+	for (int i = 0; i < loader->workerCount; i++) {
+		al_join_thread(loader->workers[i], NULL);
+		al_destroy_thread(loader->workers[i]);
+	}
+	free(loader->workers);
+	loader->workers = NULL;
+	al_destroy_cond(loader->cond);
+	al_destroy_mutex(loader->mutex);
+	loader->running = false;
+	PrintConsole(loader->game, "Decoded %d images in %f s using %d thread(s).", loader->count, al_get_time() - loader->start, loader->threads);
+}
+
+static void DecodeAll(struct AssetLoader* loader, void (*progress)(struct Game*)) {
+	int flags = al_get_new_bitmap_flags();
+	al_set_new_bitmap_flags((loader->flags & ~(ALLEGRO_VIDEO_BITMAP | ALLEGRO_CONVERT_BITMAP)) | ALLEGRO_MEMORY_BITMAP);
+	for (int i = 0; i < loader->count; i++) {
+		Decode(loader, &loader->jobs[i]);
+		loader->jobs[i].done = true;
+		Report(loader, &loader->jobs[i], progress);
+	}
+	al_set_new_bitmap_flags(flags);
+	PrintConsole(loader->game, "Decoded %d images in %f s.", loader->count, al_get_time() - loader->start);
+}
+
+void StartAssetLoader(struct AssetLoader* loader) {
+	// Like RunAssetLoader, but returns right away; poll it with PollAssetLoader.
+	// Without threads everything gets decoded right here.
+	loader->start = al_get_time();
+	if (!loader->threads) {
+		DecodeAll(loader, NULL);
+		return;
+	}
+	StartWorkers(loader);
+}
+
+bool PollAssetLoader(struct AssetLoader* loader) {
+	if (!loader->running) {
+		return true;
+	}
+	al_lock_mutex(loader->mutex);
+	bool done = loader->finished == loader->count;
+	al_unlock_mutex(loader->mutex);
+	if (done) {
+		JoinWorkers(loader);
+	}
+	return done;
+}
+
+void WaitForAssetLoader(struct AssetLoader* loader) {
+	if (!loader->running) {
+		return;
+	}
+	al_lock_mutex(loader->mutex);
+	while (loader->finished < loader->count) {
+		al_wait_cond(loader->cond, loader->mutex);
+	}
+	al_unlock_mutex(loader->mutex);
+	JoinWorkers(loader);
+}
+
+void RunAssetLoader(struct AssetLoader* loader, void (*progress)(struct Game*)) {
+	loader->start = al_get_time();
+
+	if (!loader->threads) {
+		DecodeAll(loader, progress);
+	} else {
+		StartWorkers(loader);
+
+		// progress is reported from the calling (loading) thread only
+		int reported = 0;
+		al_lock_mutex(loader->mutex);
+		while (reported < loader->count) {
+			while (loader->finished == reported) {
+				al_wait_cond(loader->cond, loader->mutex);
+			}
+			for (int i = 0; i < loader->count; i++) {
+				if (loader->jobs[i].done && !loader->jobs[i].reported) {
+					Report(loader, &loader->jobs[i], progress);
+					reported++;
+				}
+			}
+		}
+		al_unlock_mutex(loader->mutex);
+
+		JoinWorkers(loader);
+	}
+}
+
+void UploadAssets(struct AssetLoader* loader) {
+	// Converting in place keeps the pointers (and any sub-bitmaps of them) valid.
+	int flags = al_get_new_bitmap_flags();
+	al_set_new_bitmap_flags(loader->flags & ~(ALLEGRO_MEMORY_BITMAP | ALLEGRO_CONVERT_BITMAP));
+	for (int i = 0; i < loader->count; i++) {
+		if (*loader->jobs[i].bitmap && (al_get_bitmap_flags(*loader->jobs[i].bitmap) & ALLEGRO_MEMORY_BITMAP)) {
+			al_convert_bitmap(*loader->jobs[i].bitmap);
+		}
+	}
+	al_set_new_bitmap_flags(flags);
+	DestroyAssetLoader(loader);
+}
+
+void DestroyAssetLoader(struct AssetLoader* loader) {
+	// Frees the loader without touching the results; they're left as they are (in memory
+	// bitmaps, unless uploaded) and hold a cache reference each.
+	WaitForAssetLoader(loader);
+	for (int i = 0; i < loader->count; i++) {
+		free(loader->jobs[i].name);
+		free(loader->jobs[i].path);
+		ReleaseTextureSource(&loader->jobs[i].texture);
+	}
+	free(loader->jobs);
+	free(loader);
+}
@@ -0,0 +1,70 @@
+/*! \file loader.h
+ *  \brief Parallel image decoding for gamestate loading.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_LOADER_H
+#define WAKEYWAKEY_LOADER_H
+
+#include "texture.h"
+#include <libsuperderpy.h>
+
+struct LoaderJob {
+	char* name; // relative to the data directory, used as the cache key
+	char* path; // NULL when packed
+	const struct PackEntry* packed;
+	struct TextureSource texture;
+	bool hasTexture;
+	ALLEGRO_BITMAP** bitmap;
+	int steps; // how many progress steps get reported once this job finishes
+	bool done, reported;
+};
+
+/*! \brief Decodes queued images into memory bitmaps on a pool of worker threads.
+ *
+ * Queue everything in Gamestate_Load, then call RunAssetLoader (still in Gamestate_Load),
+ * which blocks until all jobs are done and reports progress as they finish.
+ * UploadAssets has to be called from Gamestate_PostLoad to move the results to the GPU.
+ * Everything goes through the bitmap cache, so release the results with ReleaseBitmap.
+ */
+struct AssetLoader {
+	struct Game* game;
+	struct LoaderJob* jobs;
+	int count, capacity;
+	int next, finished;
+	int threads;
+	int flags;
+	ALLEGRO_MUTEX* mutex;
+	ALLEGRO_COND* cond;
+	ALLEGRO_THREAD** workers;
+	int workerCount;
+	bool running;
+	double start;
+};
+
+struct AssetLoader* CreateAssetLoader(struct Game* game);
+void QueueBitmap(struct AssetLoader* loader, ALLEGRO_BITMAP** bitmap, const char* filename, int steps);
+void RunAssetLoader(struct AssetLoader* loader, void (*progress)(struct Game*));
+void UploadAssets(struct AssetLoader* loader);
+
+void StartAssetLoader(struct AssetLoader* loader);
+bool PollAssetLoader(struct AssetLoader* loader);
+void WaitForAssetLoader(struct AssetLoader* loader);
+void DestroyAssetLoader(struct AssetLoader* loader);
+
+#endif
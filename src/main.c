@@ -21,19 +21,41 @@
 #include "common.h"
 #include "defines.h"
 #include <libsuperderpy.h>
+#include <inttypes.h>
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
 
 static _Noreturn void derp(int sig) {
 	ssize_t __attribute__((unused)) n = write(STDERR_FILENO, "Segmentation fault\nI just don't know what went wrong!\n", 54);
 	abort();
 }
 
+static void PrefetchBoard(struct Game* game) {
+	// The board takes a while to load, so its images get decoded while the intros are playing.
+	// It's the same list its Gamestate_Load goes through, see assets.c.
+	struct Prefetch* prefetch = CreatePrefetch(game, "board");
+	for (int image = 0; image < BOARD_IMAGE_COUNT; image++) {
+		int count = BoardImages[image].count ? BoardImages[image].count : 1;
+		for (int i = 0; i < count; i++) {
+			PrefetchBitmap(prefetch, GetBoardImagePath(game, image, i));
+		}
+	}
+	for (int character = 0; character < BOARD_CHARACTER_COUNT; character++) {
+		int count = BoardCharacters[character].count ? BoardCharacters[character].count : 1;
+		for (int i = 0; i < count; i++) {
+			struct Character* c = CreateBoardCharacter(game, character, i);
+			PrefetchCharacter(game, prefetch, c);
+			DestroyCharacter(game, c);
+		}
+	}
+
+	StartPrefetch(game, prefetch);
+}
+
 int main(int argc, char** argv) {
 	signal(SIGSEGV, derp);
 
-	srand(time(NULL));
-
 	al_set_org_name("dosowisko.net");
 	al_set_app_name(LIBSUPERDERPY_GAMENAME_PRETTY);
 
@@ -42,14 +64,65 @@ int main(int argc, char** argv) {
 
 	al_set_window_title(game->display, LIBSUPERDERPY_GAMENAME_PRETTY);
 
-	LoadGamestate(game, "holypangolin");
-	LoadGamestate(game, "dosowisko");
-	StartGamestate(game, "holypangolin");
-
 	game->data = CreateGameData(game);
 
+	// a fixed seed together with the same input replays the same game; any value, 0 included,
+	// counts as fixed once it's given, otherwise the time is used
+	const char* seed = GetConfigOption(game, GAME_CONFIG_SECTION, "seed");
+	bool seeded = seed != NULL;
+	game->data->seed = seeded ? strtoull(seed, NULL, 0) : 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			game->data->seed = strtoull(argv[++i], NULL, 0);
+			seeded = true;
+		} else if (strcmp(argv[i], "--perf-csv") == 0 && i + 1 < argc) {
+			free(game->data->perf->csv);
+			game->data->perf->csv = strdup(argv[++i]);
+		} else if (strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) {
+			SetMemoryBudget(game, strtod(argv[++i], NULL));
+		} else if (strcmp(argv[i], "--no-textures") == 0) {
+			game->data->textures = false;
+		} else if (strcmp(argv[i], "--bench-startup") == 0) {
+			game->data->benchStartup = true;
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			game->data->headless = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				game->data->script = argv[++i];
+			}
+		}
+	}
+
+	if (!seeded) {
+		game->data->seed = time(NULL);
+	}
+	PrintConsole(game, "Random seed: %" PRIu64, game->data->seed);
+	srand(game->data->seed); // only used for cosmetic things outside of the board
+
+	if (game->data->headless || game->data->benchStartup) {
+		// straight to the board, with no sound; see RunHeadless in gamestates/board.c
+		al_set_mixer_playing(game->audio.mixer, false);
+		LoadGamestate(game, "board");
+		StartGamestate(game, "board");
+	} else {
+		// the intros are only played once, so there's no point in holding on to them afterwards
+		SetResidency(game, "holypangolin", RESIDENCY_UNLOAD_AFTER_LEAVE, NULL);
+		SetResidency(game, "dosowisko", RESIDENCY_UNLOAD_AFTER_LEAVE, NULL);
+		if (strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "prefetch", "1"), NULL, 10)) {
+			SetResidency(game, "board", RESIDENCY_PREFETCH_BEFORE_ENTER, PrefetchBoard);
+		} else {
+			SetResidency(game, "board", RESIDENCY_KEEP, NULL);
+		}
+		LoadGamestate(game, "holypangolin");
+		LoadGamestate(game, "dosowisko");
+		StartGamestate(game, "holypangolin");
+	}
+
 	game->handlers.event = &GlobalEventHandler;
 	game->handlers.destroy = &DestroyGameData;
+	game->handlers.prelogic = &PerfPreLogic;
+	game->handlers.postlogic = &GlobalPostLogic;
+	game->handlers.predraw = &PerfPreDraw;
+	game->handlers.postdraw = &PerfPostDraw;
 
 	return libsuperderpy_run(game);
 }
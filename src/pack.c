@@ -0,0 +1,237 @@
+/*! \file pack.c
+ *  \brief Single-file asset pack, memory-mapped at startup.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__) && !defined(ALLEGRO_ANDROID)
+#define PACK_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t ReadU64(const unsigned char* p) {
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; i--) {
+		value = (value << 8) | p[i];
+	}
+	return value;
+}
+
+static uint32_t ReadU32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool MapPack(struct AssetPack* pack, const char* filename) {
+#ifdef PACK_MMAP
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			pack->data = data;
+			pack->size = st.st_size;
+			pack->mapped = true;
+		}
+	}
+	close(fd);
+	return pack->mapped;
+#else
+	return false;
+#endif
+}
+
+static bool ReadPack(struct AssetPack* pack, const char* filename) {
+	// no mmap on this platform (or it failed): one sequential read of the whole thing,
+	// through Allegro so that it works with the APK file interface on Android too
+	ALLEGRO_FILE* file = al_fopen(filename, "rb");
+	if (!file) {
+		return false;
+	}
+	int64_t size = al_fsize(file);
+	if (size > 0) {
+		pack->data = malloc(size);
+		if (al_fread(file, pack->data, size) == (size_t)size) {
+			pack->size = size;
+		} else {
+			free(pack->data);
+			pack->data = NULL;
+		}
+	}
+	al_fclose(file);
+	return pack->data;
+}
+
+static bool ParseIndex(struct AssetPack* pack) {
+	if (pack->size < PACK_HEADER_SIZE || memcmp(pack->data, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+		return false;
+	}
+	pack->count = ReadU32(pack->data + 8);
+	if ((uint64_t)pack->count * PACK_ENTRY_SIZE > pack->size - PACK_HEADER_SIZE) {
+		return false;
+	}
+	pack->entries = calloc(pack->count, sizeof(struct PackEntry));
+	for (int i = 0; i < pack->count; i++) {
+		const unsigned char* p = pack->data + PACK_HEADER_SIZE + i * PACK_ENTRY_SIZE;
+		uint64_t name = ReadU64(p), offset = ReadU64(p + 8), size = ReadU64(p + 16);
+		if (name >= pack->size || offset > pack->size || size > pack->size - offset || !memchr(pack->data + name, 0, pack->size - name)) {
+			return false;
+		}
+		pack->entries[i] = (struct PackEntry){.name = (char*)pack->data + name, .data = pack->data + offset, .size = size};
+	}
+	return true;
+}
+
+struct AssetPack* OpenAssetPack(struct Game* game) {
+	if (!strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "use_pack", "1"), NULL, 10)) {
+		PrintConsole(game, "Asset pack disabled, using loose files.");
+		return NULL;
+	}
+	char* filename = FindDataFilePath(game, "data.pack");
+	if (!filename) {
+		PrintConsole(game, "No asset pack, using loose files.");
+		return NULL;
+	}
+	struct AssetPack* pack = calloc(1, sizeof(struct AssetPack));
+	if ((!MapPack(pack, filename) && !ReadPack(pack, filename)) || !ParseIndex(pack)) {
+		PrintConsole(game, "Asset pack %s is broken, using loose files.", filename);
+		CloseAssetPack(pack);
+		return NULL;
+	}
+	PrintConsole(game, "Asset pack %s: %d files, %zu bytes%s.", filename, pack->count, pack->size, pack->mapped ? ", mapped" : "");
+	return pack;
+}
+
+void CloseAssetPack(struct AssetPack* pack) {
+	if (!pack) {
+		return;
+	}
+#ifdef PACK_MMAP
+	if (pack->mapped) {
+		munmap(pack->data, pack->size);
+	} else {
+		free(pack->data);
+	}
+#else
+	free(pack->data);
+#endif
+	free(pack->entries);
+	free(pack);
+}
+
+static int CompareEntry(const void* key, const void* e) {
+	return strcmp(key, ((const struct PackEntry*)e)->name);
+}
+
+const struct PackEntry* FindPacked(struct Game* game, const char* path) {
+	struct AssetPack* pack = game->data->pack;
+	if (!pack) {
+		return NULL;
+	}
+	return bsearch(path, pack->entries, pack->count, sizeof(struct PackEntry), CompareEntry);
+}
+
+ALLEGRO_FILE* OpenPacked(const struct PackEntry* entry) {
+	return al_open_memfile(entry->data, entry->size, "r");
+}
+
+static const char* GetExtension(const char* path) {
+	// Allegro picks the decoder by the extension when loading from a file handle
+	const char* ext = strrchr(path, '.');
+	return ext ? ext : "";
+}
+
+ALLEGRO_BITMAP* LoadPackedBitmap(const struct PackEntry* entry) {
+	ALLEGRO_FILE* file = OpenPacked(entry);
+	ALLEGRO_BITMAP* bitmap = al_load_bitmap_f(file, GetExtension(entry->name));
+	al_fclose(file);
+	return bitmap;
+}
+
+ALLEGRO_BITMAP* LoadDataBitmap(struct Game* game, const char* path) {
+	struct TextureSource texture;
+	if (FindTexture(game, path, &texture)) {
+		ALLEGRO_BITMAP* bitmap = LoadTexture(&texture);
+		ReleaseTextureSource(&texture);
+		if (bitmap) {
+			return bitmap;
+		}
+		PrintConsole(game, "Texture for %s is broken, decoding the image instead.", path);
+	}
+	const struct PackEntry* entry = FindPacked(game, path);
+	if (entry) {
+		return LoadPackedBitmap(entry);
+	}
+	return al_load_bitmap(GetDataFilePath(game, path));
+}
+
+ALLEGRO_SAMPLE* LoadPackedSample(const struct PackEntry* entry) {
+	ALLEGRO_FILE* file = OpenPacked(entry);
+	ALLEGRO_SAMPLE* sample = al_load_sample_f(file, GetExtension(entry->name));
+	al_fclose(file);
+	return sample;
+}
+
+ALLEGRO_SAMPLE* LoadDataSample(struct Game* game, const char* path) {
+	const struct PackEntry* entry = FindPacked(game, path);
+	if (!entry) {
+		return al_load_sample(GetDataFilePath(game, path));
+	}
+	return LoadPackedSample(entry);
+}
+
+ALLEGRO_AUDIO_STREAM* LoadDataAudioStream(struct Game* game, const char* path, size_t buffers, unsigned int samples) {
+	const struct PackEntry* entry = FindPacked(game, path);
+	if (!entry) {
+		return al_load_audio_stream(GetDataFilePath(game, path), buffers, samples);
+	}
+	// the stream keeps reading from the memfile and closes it once destroyed
+	ALLEGRO_FILE* file = OpenPacked(entry);
+	ALLEGRO_AUDIO_STREAM* stream = al_load_audio_stream_f(file, GetExtension(path), buffers, samples);
+	if (!stream) {
+		al_fclose(file);
+	}
+	return stream;
+}
+
+ALLEGRO_FONT* LoadDataFont(struct Game* game, const char* path, int size, int flags) {
+	const struct PackEntry* entry = FindPacked(game, path);
+	if (!entry) {
+		return al_load_ttf_font(GetDataFilePath(game, path), size, flags);
+	}
+	// the font takes ownership of the memfile
+	return al_load_ttf_font_f(OpenPacked(entry), path, size, flags);
+}
+
+ALLEGRO_CONFIG* LoadDataConfig(struct Game* game, const char* path) {
+	const struct PackEntry* entry = FindPacked(game, path);
+	if (!entry) {
+		char* filename = FindDataFilePath(game, path);
+		return filename ? al_load_config_file(filename) : NULL;
+	}
+	ALLEGRO_FILE* file = OpenPacked(entry);
+	ALLEGRO_CONFIG* config = al_load_config_file_f(file);
+	al_fclose(file);
+	return config;
+}
@@ -0,0 +1,72 @@
+/*! \file pack.h
+ *  \brief Single-file asset pack, memory-mapped at startup.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_PACK_H
+#define WAKEYWAKEY_PACK_H
+
+#include <libsuperderpy.h>
+
+// On-disk layout (little endian), as written by tools/pack.c:
+//   "WWPACK1\0", uint32 entry count, uint32 reserved
+//   entry count * {uint64 name offset, uint64 data offset, uint64 size}, sorted by name
+//   NUL-terminated names, then the file contents (16-byte aligned)
+// All offsets are relative to the beginning of the file.
+#define PACK_MAGIC "WWPACK1"
+#define PACK_HEADER_SIZE 16
+#define PACK_ENTRY_SIZE 24
+#define PACK_ALIGNMENT 16
+
+struct PackEntry {
+	const char* name; // relative to the data directory
+	unsigned char* data; // points into the mapping
+	size_t size;
+};
+
+/*! \brief data.pack, mapped into memory for the whole lifetime of the game.
+ *
+ * Files found in the pack are handed to Allegro as memfiles over the mapping, so no
+ * file gets opened or seeked. Anything that's not in the pack (or all of it, when there's
+ * no pack or [WakeyWakey] use_pack is 0) gets loaded from loose files instead.
+ * Lookups don't modify anything, so they're safe to do from the loader's workers.
+ */
+struct AssetPack {
+	unsigned char* data;
+	size_t size;
+	bool mapped; // false when the whole file had to be read into memory instead
+	struct PackEntry* entries;
+	int count;
+};
+
+struct AssetPack* OpenAssetPack(struct Game* game);
+void CloseAssetPack(struct AssetPack* pack);
+
+const struct PackEntry* FindPacked(struct Game* game, const char* path);
+ALLEGRO_FILE* OpenPacked(const struct PackEntry* entry);
+ALLEGRO_BITMAP* LoadPackedBitmap(const struct PackEntry* entry);
+ALLEGRO_SAMPLE* LoadPackedSample(const struct PackEntry* entry);
+
+// Packed when possible, loose otherwise. Paths are relative to the data directory.
+ALLEGRO_BITMAP* LoadDataBitmap(struct Game* game, const char* path);
+ALLEGRO_SAMPLE* LoadDataSample(struct Game* game, const char* path);
+ALLEGRO_AUDIO_STREAM* LoadDataAudioStream(struct Game* game, const char* path, size_t buffers, unsigned int samples);
+ALLEGRO_FONT* LoadDataFont(struct Game* game, const char* path, int size, int flags);
+ALLEGRO_CONFIG* LoadDataConfig(struct Game* game, const char* path); // NULL when it doesn't exist
+
+#endif
@@ -0,0 +1,211 @@
+/*! \file perf.c
+ *  \brief Frame time measurement and debug overlay.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#include <stdio.h>
+
+#define HISTOGRAM_BUCKETS 40 // one per millisecond; the last one takes everything above
+
+static const char* PhaseNames[PERF_PHASES] = {"logic", "draw", "other", "frame"};
+
+struct PerfOverlay* CreatePerf(struct Game* game, const char* csv) {
+	struct PerfOverlay* perf = calloc(1, sizeof(struct PerfOverlay));
+	perf->font = al_create_builtin_font();
+	if (csv && csv[0]) {
+		perf->csv = strdup(csv);
+	}
+	return perf;
+}
+
+static int GetGamestateIndex(struct Game* game, struct PerfOverlay* perf) {
+	// Gamestate names are copied, so they're still there for the CSV dump at exit.
+	struct Gamestate* gamestate = GetCurrentGamestate(game);
+	const char* name = gamestate ? gamestate->name : "-";
+	for (int i = 0; i < perf->gamestateCount; i++) {
+		if (strcmp(perf->gamestates[i], name) == 0) {
+			return i;
+		}
+	}
+	if (perf->gamestateCount == PERF_MAX_GAMESTATES) {
+		return 0;
+	}
+	perf->gamestates[perf->gamestateCount] = strdup(name);
+	return perf->gamestateCount++;
+}
+
+static void AddSample(struct Game* game, struct PerfOverlay* perf, struct PerfSample* sample) {
+	perf->window[perf->next] = *sample;
+	perf->next = (perf->next + 1) % PERF_WINDOW;
+	if (perf->filled < PERF_WINDOW) {
+		perf->filled++;
+	}
+	if (!perf->csv) {
+		return;
+	}
+	if (perf->count == perf->capacity) {
+		perf->capacity = perf->capacity ? perf->capacity * 2 : 4096;
+		perf->samples = realloc(perf->samples, sizeof(struct PerfSample) * perf->capacity);
+	}
+	perf->samples[perf->count++] = *sample;
+}
+
+void PerfPreLogic(struct Game* game, double delta) {
+	game->data->perf->logicStart = al_get_time();
+}
+
+void PerfPostLogic(struct Game* game, double delta) {
+	struct PerfOverlay* perf = game->data->perf;
+	// there may be several logic ticks per frame, or none
+	perf->logic += al_get_time() - perf->logicStart;
+}
+
+void PerfPreDraw(struct Game* game) {
+	// A sample covers everything since the previous frame started drawing, so it includes
+	// the previous Gamestate_Draw, the logic ticks after it and the flip.
+	struct PerfOverlay* perf = game->data->perf;
+	double now = al_get_time();
+	if (perf->lastFrame) {
+		struct PerfSample sample = {.time = now, .gamestate = GetGamestateIndex(game, perf)};
+		sample.phases[PERF_FRAME] = now - perf->lastFrame;
+		sample.phases[PERF_LOGIC] = perf->logic;
+		sample.phases[PERF_DRAW] = perf->draw;
+		sample.phases[PERF_OTHER] = fmax(0.0, sample.phases[PERF_FRAME] - perf->logic - perf->draw);
+		AddSample(game, perf, &sample);
+	}
+	perf->lastFrame = now;
+	perf->drawStart = now;
+	perf->logic = 0;
+}
+
+static int CompareFloats(const void* a, const void* b) {
+	float f1 = *(const float*)a, f2 = *(const float*)b;
+	return (f1 > f2) - (f1 < f2);
+}
+
+static void DrawOverlay(struct Game* game, struct PerfOverlay* perf) {
+	float values[PERF_WINDOW];
+	int line = al_get_font_line_height(perf->font);
+	ALLEGRO_COLOR white = al_map_rgb(255, 255, 255);
+
+	al_draw_filled_rectangle(0, 0, 200, line * 8 + 60, al_map_rgba(0, 0, 0, 192));
+
+	struct PerfSample* last = &perf->window[(perf->next + PERF_WINDOW - 1) % PERF_WINDOW];
+	al_draw_textf(perf->font, white, 4, 4, ALLEGRO_ALIGN_LEFT, "%s  %5.1f ms", perf->gamestates[last->gamestate], last->phases[PERF_FRAME] * 1000);
+	al_draw_text(perf->font, white, 4, 4 + line * 2, ALLEGRO_ALIGN_LEFT, "          p50    p95    p99");
+	for (int p = 0; p < PERF_PHASES; p++) {
+		for (int i = 0; i < perf->filled; i++) {
+			values[i] = perf->window[i].phases[p] * 1000;
+		}
+		qsort(values, perf->filled, sizeof(float), CompareFloats);
+		al_draw_textf(perf->font, white, 4, 4 + line * (3 + p), ALLEGRO_ALIGN_LEFT, "%-6s %6.2f %6.2f %6.2f", PhaseNames[p],
+			values[perf->filled / 2], values[perf->filled * 95 / 100], values[perf->filled * 99 / 100]);
+	}
+
+	struct SoundEffects* sfx = game->data->sfx;
+	if (atomic_load(&sfx->latencyCount)) {
+		al_draw_textf(perf->font, white, 4, 4 + line * 7, ALLEGRO_ALIGN_LEFT, "sfx    %6.2f ms (max %.2f)",
+			atomic_load(&sfx->latencyLast) / 1000.0, atomic_load(&sfx->latencyMax) / 1000.0);
+	}
+
+	// frame time histogram over the window
+	int buckets[HISTOGRAM_BUCKETS] = {0}, max = 1;
+	for (int i = 0; i < perf->filled; i++) {
+		int b = perf->window[i].phases[PERF_FRAME] * 1000;
+		if (b >= HISTOGRAM_BUCKETS) {
+			b = HISTOGRAM_BUCKETS - 1;
+		}
+		if (++buckets[b] > max) {
+			max = buckets[b];
+		}
+	}
+	float bottom = line * 8 + 56;
+	for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+		// green up to 60 FPS, yellow up to 30, red beyond
+		ALLEGRO_COLOR color = b < 17 ? al_map_rgb(0, 200, 0) : (b < 33 ? al_map_rgb(220, 200, 0) : al_map_rgb(220, 0, 0));
+		al_draw_filled_rectangle(4 + b * 4.8, bottom - 48.0 * buckets[b] / max, 4 + b * 4.8 + 4, bottom, color);
+	}
+}
+
+static void ReportStartup(struct Game* game) {
+	struct Gamestate* gamestate = GetCurrentGamestate(game);
+	if (!gamestate || !gamestate->started || strcmp(gamestate->name, "board") != 0) {
+		return;
+	}
+	// al_get_time counts from al_init, which the engine calls right at the start
+	printf("startup: first frame after %.3f s (%s)\n", al_get_time(), game->data->textures ? "textures" : "images");
+	fflush(stdout);
+	game->data->benchStartup = false;
+	UnloadAllGamestates(game);
+}
+
+void PerfPostDraw(struct Game* game) {
+	struct PerfOverlay* perf = game->data->perf;
+	perf->draw = al_get_time() - perf->drawStart;
+
+	if (game->data->benchStartup) {
+		ReportStartup(game);
+	}
+
+	if (!perf->visible || !perf->filled) {
+		return;
+	}
+
+	// draw in window pixels, on top of everything and outside of the viewport
+	ALLEGRO_TRANSFORM transform, orig = *al_get_current_transform();
+	int x, y, w, h;
+	al_get_clipping_rectangle(&x, &y, &w, &h);
+	al_reset_clipping_rectangle();
+	al_identity_transform(&transform);
+	al_scale_transform(&transform, 2, 2);
+	al_use_transform(&transform);
+	DrawOverlay(game, perf);
+	al_use_transform(&orig);
+	al_set_clipping_rectangle(x, y, w, h);
+}
+
+static void WriteCSV(struct Game* game, struct PerfOverlay* perf) {
+	FILE* file = fopen(perf->csv, "w");
+	if (!file) {
+		PrintConsole(game, "Could not write frame times to %s!", perf->csv);
+		return;
+	}
+	fprintf(file, "time,gamestate,logic_ms,draw_ms,other_ms,frame_ms\n");
+	for (size_t i = 0; i < perf->count; i++) {
+		struct PerfSample* s = &perf->samples[i];
+		fprintf(file, "%.6f,%s,%.3f,%.3f,%.3f,%.3f\n", s->time, perf->gamestates[s->gamestate],
+			s->phases[PERF_LOGIC] * 1000, s->phases[PERF_DRAW] * 1000, s->phases[PERF_OTHER] * 1000, s->phases[PERF_FRAME] * 1000);
+	}
+	fclose(file);
+	PrintConsole(game, "Wrote %zu frame time samples to %s.", perf->count, perf->csv);
+}
+
+void DestroyPerf(struct Game* game, struct PerfOverlay* perf) {
+	if (perf->csv) {
+		WriteCSV(game, perf);
+	}
+	for (int i = 0; i < perf->gamestateCount; i++) {
+		free(perf->gamestates[i]);
+	}
+	al_destroy_font(perf->font);
+	free(perf->samples);
+	free(perf->csv);
+	free(perf);
+}
@@ -0,0 +1,74 @@
+/*! \file perf.h
+ *  \brief Frame time measurement and debug overlay.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_PERF_H
+#define WAKEYWAKEY_PERF_H
+
+#include <libsuperderpy.h>
+
+#define PERF_WINDOW 240 // frames the overlay statistics are computed from
+#define PERF_MAX_GAMESTATES 8
+
+enum PerfPhase {
+	PERF_LOGIC, // all Gamestate_Logic calls since the previous frame
+	PERF_DRAW, // Gamestate_Draw
+	PERF_OTHER, // whatever else happened between two frames: events, flip, waiting for vsync
+	PERF_FRAME, // time between two frames
+	PERF_PHASES
+};
+
+struct PerfSample {
+	double time;
+	int gamestate; // index into PerfOverlay.gamestates
+	float phases[PERF_PHASES]; // in seconds
+};
+
+/*! \brief Collects per-phase frame times through the engine's pre/post logic and draw handlers.
+ *
+ * Toggled with F3 (see GlobalEventHandler). When a CSV path is set, every sample is kept
+ * and written out by DestroyPerf.
+ */
+struct PerfOverlay {
+	bool visible;
+	ALLEGRO_FONT* font;
+
+	double logicStart, drawStart, lastFrame;
+	float logic, draw;
+
+	char* gamestates[PERF_MAX_GAMESTATES];
+	int gamestateCount;
+
+	struct PerfSample window[PERF_WINDOW];
+	int next, filled;
+
+	char* csv;
+	struct PerfSample* samples;
+	size_t count, capacity;
+};
+
+struct PerfOverlay* CreatePerf(struct Game* game, const char* csv);
+void DestroyPerf(struct Game* game, struct PerfOverlay* perf);
+
+void PerfPreLogic(struct Game* game, double delta);
+void PerfPostLogic(struct Game* game, double delta);
+void PerfPreDraw(struct Game* game);
+void PerfPostDraw(struct Game* game);
+
+#endif
@@ -0,0 +1,149 @@
+/*! \file prefetch.c
+ *  \brief Decodes the images of a gamestate before it gets loaded.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+struct Prefetch* CreatePrefetch(struct Game* game, const char* gamestate) {
+	struct Prefetch* prefetch = calloc(1, sizeof(struct Prefetch));
+	prefetch->gamestate = strdup(gamestate);
+	return prefetch;
+}
+
+void PrefetchBitmap(struct Prefetch* prefetch, const char* path) {
+	for (int i = 0; i < prefetch->count; i++) {
+		if (strcmp(prefetch->paths[i], path) == 0) {
+			return;
+		}
+	}
+	prefetch->paths = realloc(prefetch->paths, sizeof(char*) * (prefetch->count + 1));
+	prefetch->paths[prefetch->count++] = strdup(path);
+}
+
+void PrefetchCharacter(struct Game* game, struct Prefetch* prefetch, struct Character* character) {
+	// Takes whatever LoadCharacterSpritesheets would load for the registered spritesheets:
+	// the atlas pages when there's an atlas, the frame files otherwise.
+	struct Atlas* atlas = OpenAtlas(game, character->name);
+	if (atlas && atlas->pageCount) {
+		for (int i = 0; i < atlas->pageCount; i++) {
+			const char* path = GetAtlasPagePath(atlas, i);
+			if (path) {
+				PrefetchBitmap(prefetch, path);
+			}
+		}
+	} else {
+		for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+			for (int i = 0; i < s->frameCount; i++) {
+				if (s->frames[i].file) {
+					char path[255];
+					snprintf(path, 255, "sprites/%s/%s", character->name, s->frames[i].file);
+					PrefetchBitmap(prefetch, path);
+				}
+			}
+		}
+	}
+	DestroyAtlas(game, atlas);
+}
+
+void StartPrefetch(struct Game* game, struct Prefetch* prefetch) {
+	// Has to be called from the main thread, as queuing resolves data paths.
+	prefetch->start = al_get_time();
+	prefetch->mutex = al_create_mutex();
+	prefetch->bitmaps = calloc(prefetch->count, sizeof(ALLEGRO_BITMAP*));
+	prefetch->loader = CreateAssetLoader(game);
+	prefetch->flags = prefetch->loader->flags;
+	for (int i = 0; i < prefetch->count; i++) {
+		QueueBitmap(prefetch->loader, &prefetch->bitmaps[i], prefetch->paths[i], 0);
+	}
+	StartAssetLoader(prefetch->loader);
+	game->data->prefetch = prefetch;
+}
+
+void UpdatePrefetch(struct Game* game) {
+	struct Prefetch* prefetch = game->data->prefetch;
+	if (!prefetch) {
+		return;
+	}
+	struct Gamestate* gamestate = FindGamestate(game, prefetch->gamestate);
+	bool needed = gamestate && gamestate->pending_load;
+	al_lock_mutex(prefetch->mutex);
+	if (prefetch->loader && (needed || PollAssetLoader(prefetch->loader))) {
+		// Everything goes up at once; it's a single longer frame in the middle of an intro.
+		// When the gamestate is about to be loaded, the rest has to be waited for right here,
+		// so that its Gamestate_Load never sees these bitmaps before they're uploaded.
+		WaitForAssetLoader(prefetch->loader);
+		UploadAssets(prefetch->loader);
+		prefetch->loader = NULL;
+		PrintConsole(game, "Prefetched %d image(s) in %f s.", prefetch->count, al_get_time() - prefetch->start);
+	}
+	al_unlock_mutex(prefetch->mutex);
+}
+
+void WaitForPrefetch(struct Game* game) {
+	// Usually everything has been uploaded by UpdatePrefetch by now. If not, the results are
+	// taken over as they are (in memory bitmaps), so the main thread doesn't convert them
+	// while the gamestate is creating sub-bitmaps of them; they're cache hits for the
+	// gamestate's own loader, which uploads them along with everything else.
+	struct Prefetch* prefetch = game->data->prefetch;
+	if (!prefetch) {
+		return;
+	}
+	al_lock_mutex(prefetch->mutex);
+	if (prefetch->loader) {
+		DestroyAssetLoader(prefetch->loader); // waits for the workers first
+		prefetch->loader = NULL;
+		prefetch->takenOver = true;
+		PrintConsole(game, "Prefetch for %s wasn't uploaded in time, leaving it to the gamestate.", prefetch->gamestate);
+	}
+	al_unlock_mutex(prefetch->mutex);
+}
+
+void FinishPrefetch(struct Game* game) {
+	struct Prefetch* prefetch = game->data->prefetch;
+	if (!prefetch) {
+		return;
+	}
+	if (prefetch->loader) {
+		DestroyAssetLoader(prefetch->loader);
+	}
+	if (prefetch->takenOver) {
+		// whatever the gamestate didn't load through its own loader is still in memory
+		int flags = al_get_new_bitmap_flags();
+		al_set_new_bitmap_flags(prefetch->flags & ~(ALLEGRO_MEMORY_BITMAP | ALLEGRO_CONVERT_BITMAP));
+		for (int i = 0; i < prefetch->count; i++) {
+			if (prefetch->bitmaps[i] && (al_get_bitmap_flags(prefetch->bitmaps[i]) & ALLEGRO_MEMORY_BITMAP)) {
+				al_convert_bitmap(prefetch->bitmaps[i]);
+			}
+		}
+		al_set_new_bitmap_flags(flags);
+	}
+	for (int i = 0; i < prefetch->count; i++) {
+		ReleaseBitmap(game, prefetch->bitmaps[i]);
+		free(prefetch->paths[i]);
+	}
+	if (prefetch->mutex) {
+		al_destroy_mutex(prefetch->mutex);
+	}
+	free(prefetch->bitmaps);
+	free(prefetch->paths);
+	free(prefetch->gamestate);
+	free(prefetch);
+	game->data->prefetch = NULL;
+}
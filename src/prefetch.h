@@ -0,0 +1,63 @@
+/*! \file prefetch.h
+ *  \brief Decodes the images of a gamestate before it gets loaded.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_PREFETCH_H
+#define WAKEYWAKEY_PREFETCH_H
+
+#include "loader.h"
+#include <libsuperderpy.h>
+
+/*! \brief Images of a gamestate decoded into the bitmap cache while something else is running.
+ *
+ * Collect the paths with PrefetchBitmap and PrefetchCharacter, then hand the prefetch over
+ * with StartPrefetch. The images get decoded on the loader's worker threads and uploaded
+ * from GlobalPostLogic once done, or as soon as the gamestate they're for is about to be
+ * loaded (waiting for the rest to be decoded), so its Gamestate_Load gets them uploaded.
+ * The gamestate itself keeps loading its assets as usual, they just turn into cache hits;
+ * it should call WaitForPrefetch at the beginning of its Gamestate_Load (so nothing gets
+ * decoded twice) and FinishPrefetch at the end of its Gamestate_PostLoad, which drops the
+ * references held by the prefetch.
+ *
+ * Should the loading thread get there first anyway, WaitForPrefetch takes the results over
+ * as memory bitmaps, so the main thread never converts them while the gamestate is using
+ * them; they're uploaded with the gamestate's own results, or by FinishPrefetch.
+ */
+struct Prefetch {
+	char* gamestate;
+	char** paths;
+	int count;
+	ALLEGRO_BITMAP** bitmaps;
+	struct AssetLoader* loader; // NULL once uploaded or taken over
+	ALLEGRO_MUTEX* mutex; // Gamestate_Load runs on the engine's loading thread
+	int flags; // of the loader, for uploading what got taken over
+	bool takenOver; // by WaitForPrefetch, before being uploaded
+	double start;
+};
+
+struct Prefetch* CreatePrefetch(struct Game* game, const char* gamestate);
+void PrefetchBitmap(struct Prefetch* prefetch, const char* path);
+void PrefetchCharacter(struct Game* game, struct Prefetch* prefetch, struct Character* character);
+void StartPrefetch(struct Game* game, struct Prefetch* prefetch);
+
+void UpdatePrefetch(struct Game* game);
+void WaitForPrefetch(struct Game* game);
+void FinishPrefetch(struct Game* game);
+
+#endif
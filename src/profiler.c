@@ -0,0 +1,199 @@
+/*! \file profiler.c
+ *  \brief Per-action timing and queue depth instrumentation for timelines.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// The engine's timeline can't be hooked into, so every profiled action is added as
+// RunProfiled with a ProfiledAction as its only argument. RunProfiled puts the original
+// argument in place for the duration of the real callback, so TM_Arg works as usual.
+// Both argument lists live in the pooled record; they're taken away from the action before
+// the engine gets to free them.
+
+static const char* StateNames[] = {"init", "start", "running", "pause", "resume", "destroy"};
+
+struct TimelineProfiler* CreateTimelineProfiler(struct Timeline* timeline, int capacity) {
+	struct TimelineProfiler* profiler = calloc(1, sizeof(struct TimelineProfiler));
+	profiler->timeline = timeline;
+	profiler->capacity = capacity;
+	profiler->pool = calloc(capacity, sizeof(struct ProfiledAction));
+	for (int i = 0; i < capacity; i++) {
+		profiler->pool[i].pooled = true;
+		profiler->pool[i].next = (i + 1 < capacity) ? &profiler->pool[i + 1] : NULL;
+	}
+	profiler->free = capacity ? &profiler->pool[0] : NULL;
+	return profiler;
+}
+
+static struct ProfiledAction* TakeProfiledAction(struct TimelineProfiler* profiler) {
+	struct ProfiledAction* profiled = profiler->free;
+	if (profiled) {
+		profiler->free = profiled->next;
+	} else {
+		PrintConsole(profiler->timeline->game, "Action pool of timeline %s exhausted (%d), allocating.", profiler->timeline->name, profiler->capacity);
+		profiled = calloc(1, sizeof(struct ProfiledAction));
+	}
+	profiler->used++;
+	if (profiler->used > profiler->peak) {
+		profiler->peak = profiler->used;
+	}
+	return profiled;
+}
+
+static void ReturnProfiledAction(struct TimelineProfiler* profiler, struct ProfiledAction* profiled) {
+	profiler->used--;
+	if (!profiled->pooled) {
+		free(profiled);
+		return;
+	}
+	profiled->next = profiler->free;
+	profiler->free = profiled;
+}
+
+void DestroyTimelineProfiler(struct TimelineProfiler* profiler) {
+	// Has to outlive the timeline, as destroying it still runs the DESTROY states.
+	struct ActionStats* stats = profiler->actions;
+	while (stats) {
+		struct ActionStats* next = stats->next;
+		free(stats->name);
+		free(stats);
+		stats = next;
+	}
+	free(profiler->pool);
+	free(profiler);
+}
+
+struct ActionStats* GetActionStats(struct TimelineProfiler* profiler, const char* name) {
+	for (struct ActionStats* stats = profiler->actions; stats; stats = stats->next) {
+		if (strcmp(stats->name, name) == 0) {
+			return stats;
+		}
+	}
+	return NULL;
+}
+
+static struct ActionStats* GetOrCreateActionStats(struct TimelineProfiler* profiler, const char* name) {
+	struct ActionStats* stats = GetActionStats(profiler, name);
+	if (!stats) {
+		stats = calloc(1, sizeof(struct ActionStats));
+		stats->name = strdup(name);
+		stats->next = profiler->actions;
+		profiler->actions = stats;
+	}
+	return stats;
+}
+
+static TM_ACTION(RunProfiled) {
+	struct ProfiledAction* profiled = TM_Arg(0);
+	struct TM_Arguments* wrapper = action->arguments;
+	enum TM_ActionState state = action->state;
+
+	action->arguments = profiled->arg.value ? &profiled->arg : NULL;
+	double start = al_get_time();
+	bool result = profiled->function(game, data, action);
+	double time = al_get_time() - start;
+	action->arguments = wrapper;
+
+	struct ActionStats* stats = profiled->stats;
+	stats->time[state] += time;
+	if (time > stats->max[state]) {
+		stats->max[state] = time;
+	}
+	if (state == TM_ACTIONSTATE_RUNNING) {
+		stats->frames++;
+		profiled->frames++;
+		if (profiled->frames > stats->maxFrames) {
+			stats->maxFrames = profiled->frames;
+		}
+	}
+	if (state == TM_ACTIONSTATE_DESTROY) {
+		action->arguments = NULL; // not the engine's to free
+		ReturnProfiledAction(profiled->profiler, profiled);
+	}
+	return result;
+}
+
+static struct TM_Arguments* Wrap(struct TimelineProfiler* profiler, TM_ActionCallback* function, void* arg, const char* name) {
+	struct ProfiledAction* profiled = TakeProfiledAction(profiler);
+	profiled->profiler = profiler;
+	profiled->function = function;
+	profiled->wrapper = (struct TM_Arguments){.value = profiled};
+	profiled->arg = (struct TM_Arguments){.value = arg};
+	profiled->frames = 0;
+	profiled->stats = GetOrCreateActionStats(profiler, name);
+	profiled->stats->instances++;
+	return &profiled->wrapper;
+}
+
+struct TM_Action* AddProfiledAction(struct TimelineProfiler* profiler, TM_ActionCallback* function, void* arg, const char* name) {
+	return TM_AddNamedAction(profiler->timeline, RunProfiled, Wrap(profiler, function, arg, name), name);
+}
+
+struct TM_Action* AddProfiledBackgroundAction(struct TimelineProfiler* profiler, TM_ActionCallback* function, void* arg, int delay, const char* name) {
+	return TM_AddNamedBackgroundAction(profiler->timeline, RunProfiled, Wrap(profiler, function, arg, name), delay, name);
+}
+
+struct TM_Action* AddProfiledQueuedBackgroundAction(struct TimelineProfiler* profiler, TM_ActionCallback* function, void* arg, int delay, const char* name) {
+	// The engine doesn't have a named variant of this one; the stats still get the name.
+	return TM_AddQueuedBackgroundAction(profiler->timeline, RunProfiled, Wrap(profiler, function, arg, name), delay);
+}
+
+void SampleTimeline(struct TimelineProfiler* profiler) {
+	struct QueueDepth depth = {0};
+	for (struct TM_Action* action = profiler->timeline->queue; action; action = action->next) {
+		depth.queue++;
+	}
+	for (struct TM_Action* action = profiler->timeline->background; action; action = action->next) {
+		depth.background++;
+	}
+	profiler->depth[profiler->next] = depth;
+	profiler->next = (profiler->next + 1) % PROFILER_DEPTH_SAMPLES;
+	if (profiler->filled < PROFILER_DEPTH_SAMPLES) {
+		profiler->filled++;
+	}
+	if (depth.queue > profiler->maxDepth.queue) {
+		profiler->maxDepth.queue = depth.queue;
+	}
+	if (depth.background > profiler->maxDepth.background) {
+		profiler->maxDepth.background = depth.background;
+	}
+}
+
+void PrintTimelineProfile(struct Game* game, struct TimelineProfiler* profiler) {
+	PrintConsole(game, "Timeline %s (%d of %d pooled actions in use, peak %d):", profiler->timeline->name, profiler->used, profiler->capacity, profiler->peak);
+	for (struct ActionStats* stats = profiler->actions; stats; stats = stats->next) {
+		PrintConsole(game, "  %s: %d instance(s), %d frame(s) running (max %d)", stats->name, stats->instances, stats->frames, stats->maxFrames);
+		for (int s = TM_ACTIONSTATE_START; s <= TM_ACTIONSTATE_DESTROY; s++) {
+			if (stats->time[s] > 0) {
+				PrintConsole(game, "    %-8s total %8.3f ms, max %7.3f ms", StateNames[s], stats->time[s] * 1000, stats->max[s] * 1000);
+			}
+		}
+	}
+
+	double queue = 0, background = 0;
+	for (int i = 0; i < profiler->filled; i++) {
+		queue += profiler->depth[i].queue;
+		background += profiler->depth[i].background;
+	}
+	if (profiler->filled) {
+		PrintConsole(game, "  queue depth over the last %d ticks: main %.2f avg (max %d ever), background %.2f avg (max %d ever)",
+			profiler->filled, queue / profiler->filled, profiler->maxDepth.queue, background / profiler->filled, profiler->maxDepth.background);
+	}
+}
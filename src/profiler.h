@@ -0,0 +1,86 @@
+/*! \file profiler.h
+ *  \brief Per-action timing and queue depth instrumentation for timelines.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_PROFILER_H
+#define WAKEYWAKEY_PROFILER_H
+
+#include <libsuperderpy.h>
+
+#define PROFILER_DEPTH_SAMPLES 1024 // Logic ticks of queue depth history kept
+
+struct ActionStats {
+	char* name;
+	int instances;
+	double time[TM_ACTIONSTATE_DESTROY + 1], max[TM_ACTIONSTATE_DESTROY + 1]; // per state, in seconds
+	int frames, maxFrames; // RUNNING calls, in total and for the longest lived instance
+	struct ActionStats* next;
+};
+
+struct ProfiledAction {
+	struct TimelineProfiler* profiler;
+	TM_ActionCallback* function;
+	struct TM_Arguments wrapper; // what the timeline gets as the arguments of RunProfiled
+	struct TM_Arguments arg; // what the real callback gets, if anything
+	struct ActionStats* stats;
+	int frames;
+	bool pooled;
+	struct ProfiledAction* next; // in the free list
+};
+
+struct QueueDepth {
+	int queue, background;
+};
+
+/*! \brief Wraps timeline actions to measure them.
+ *
+ * Use the Add*ProfiledAction functions instead of their TM_ counterparts and call
+ * SampleTimeline after each TM_Process. Actions added directly with TM_* still
+ * run, they're just not measured.
+ *
+ * Records of actions in flight come from a pool sized at creation, and carry the argument
+ * lists of both the wrapper and the real callback (a single TM_Arg(0) value, or none), so
+ * adding actions doesn't allocate on our side; the pool only grows (with a warning) when
+ * it runs out. The action nodes themselves are still allocated by the engine.
+ */
+struct TimelineProfiler {
+	struct Timeline* timeline;
+	struct ActionStats* actions;
+
+	struct ProfiledAction* pool;
+	struct ProfiledAction* free;
+	int capacity, used, peak;
+
+	struct QueueDepth depth[PROFILER_DEPTH_SAMPLES];
+	int next, filled;
+	struct QueueDepth maxDepth;
+};
+
+struct TimelineProfiler* CreateTimelineProfiler(struct Timeline* timeline, int capacity);
+void DestroyTimelineProfiler(struct TimelineProfiler* profiler);
+
+struct TM_Action* AddProfiledAction(struct TimelineProfiler* profiler, TM_ActionCallback* function, void* arg, const char* name);
+struct TM_Action* AddProfiledBackgroundAction(struct TimelineProfiler* profiler, TM_ActionCallback* function, void* arg, int delay, const char* name);
+struct TM_Action* AddProfiledQueuedBackgroundAction(struct TimelineProfiler* profiler, TM_ActionCallback* function, void* arg, int delay, const char* name);
+
+void SampleTimeline(struct TimelineProfiler* profiler);
+struct ActionStats* GetActionStats(struct TimelineProfiler* profiler, const char* name);
+void PrintTimelineProfile(struct Game* game, struct TimelineProfiler* profiler);
+
+#endif
@@ -0,0 +1,30 @@
+/*! \file random.c
+ *  \brief Small, seedable pseudo-random number streams.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "random.h"
+
+void SeedRandom(struct Random* rng, uint64_t seed) {
+	// SplitMix64 spreads similar seeds (like consecutive ones) over the whole state
+	// and never gives zero, which xorshift can't get out of.
+	seed += 0x9E3779B97F4A7C15ull;
+	seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+	seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+	rng->state = (seed ^ (seed >> 31)) | 1;
+}
@@ -0,0 +1,50 @@
+/*! \file random.h
+ *  \brief Small, seedable pseudo-random number streams.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_RANDOM_H
+#define WAKEYWAKEY_RANDOM_H
+
+#include <stdint.h>
+
+/*! \brief A xorshift64* stream.
+ *
+ * Each user keeps its own stream, so identical seeds give identical sequences no matter
+ * what else is running, and threads don't contend on shared state like with rand().
+ * Doesn't depend on Allegro or libsuperderpy, so tools can build it as well.
+ */
+struct Random {
+	uint64_t state;
+};
+
+void SeedRandom(struct Random* rng, uint64_t seed);
+
+static inline uint32_t NextRandom(struct Random* rng) {
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+	return (rng->state * 0x2545F4914F6CDD1Dull) >> 32;
+}
+
+// Uniform-ish in [0, n); scaled with a multiply instead of a modulo.
+static inline int RandomInt(struct Random* rng, int n) {
+	return ((uint64_t)NextRandom(rng) * n) >> 32;
+}
+
+#endif
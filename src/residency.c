@@ -0,0 +1,134 @@
+/*! \file residency.c
+ *  \brief Per-gamestate residency policies and memory report.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+static const char* PolicyName(enum ResidencyPolicy policy) {
+	switch (policy) {
+		case RESIDENCY_KEEP:
+			return "keep";
+		case RESIDENCY_UNLOAD_AFTER_LEAVE:
+			return "unload after leave";
+		case RESIDENCY_PREFETCH_BEFORE_ENTER:
+			return "prefetch before enter";
+	}
+	return "?";
+}
+
+struct Residency* CreateResidency(struct Game* game) {
+	return calloc(1, sizeof(struct Residency));
+}
+
+void DestroyResidency(struct Game* game, struct Residency* residency) {
+	struct ResidentGamestate* r = residency->gamestates;
+	while (r) {
+		struct ResidentGamestate* next = r->next;
+		free(r->name);
+		free(r);
+		r = next;
+	}
+	free(residency);
+}
+
+void SetResidency(struct Game* game, const char* name, enum ResidencyPolicy policy, void (*prefetch)(struct Game* game)) {
+	struct ResidentGamestate** r = &game->data->residency->gamestates;
+	while (*r && strcmp((*r)->name, name) != 0) {
+		r = &(*r)->next;
+	}
+	if (!*r) {
+		// appended, so the list keeps the order of the session
+		*r = calloc(1, sizeof(struct ResidentGamestate));
+		(*r)->name = strdup(name);
+	}
+	(*r)->policy = policy;
+	(*r)->prefetch = prefetch;
+}
+
+static bool IsBusy(struct Gamestate* gamestate) {
+	return gamestate->started || gamestate->pending_load || gamestate->pending_start || gamestate->pending_unload;
+}
+
+void UpdateResidency(struct Game* game) {
+	struct Residency* residency = game->data->residency;
+	bool changed = false;
+
+	for (struct ResidentGamestate* r = residency->gamestates; r; r = r->next) {
+		struct Gamestate* gamestate = FindGamestate(game, r->name);
+		if (gamestate && gamestate->started && !r->entered) {
+			r->entered = true;
+			// whatever comes later gets prefetched, whatever came earlier is done with
+			for (struct ResidentGamestate* later = r->next; later; later = later->next) {
+				if (later->policy == RESIDENCY_PREFETCH_BEFORE_ENTER && !later->prefetched && later->prefetch) {
+					later->prefetched = true;
+					later->prefetch(game);
+				}
+			}
+			for (struct ResidentGamestate* earlier = residency->gamestates; earlier != r; earlier = earlier->next) {
+				earlier->entered = true;
+			}
+		}
+	}
+
+	for (struct ResidentGamestate* r = residency->gamestates; r; r = r->next) {
+		struct Gamestate* gamestate = FindGamestate(game, r->name);
+		bool loaded = gamestate && gamestate->loaded;
+		if (loaded != r->loaded) {
+			r->loaded = loaded;
+			r->unloading = false;
+			changed = true;
+		}
+		if (r->policy != RESIDENCY_UNLOAD_AFTER_LEAVE || !r->entered || !loaded || r->unloading || IsBusy(gamestate)) {
+			continue;
+		}
+		PrintConsole(game, "Residency: %s has been left, unloading.", r->name);
+		UnloadGamestate(game, r->name);
+		r->unloading = true;
+		residency->unloaded++;
+	}
+
+	if (changed && game->config.debug) {
+		PrintResidencyReport(game);
+	}
+}
+
+void PrintResidencyReport(struct Game* game) {
+	struct Residency* residency = game->data->residency;
+	PrintConsole(game, "Residency: %d gamestate(s) unloaded by policy so far.", residency->unloaded);
+	size_t total = 0;
+	for (struct Gamestate* gamestate = game->_priv.gamestates; gamestate; gamestate = gamestate->next) {
+		struct ResidentGamestate* r = residency->gamestates;
+		while (r && strcmp(r->name, gamestate->name) != 0) {
+			r = r->next;
+		}
+		const char* state = gamestate->started ? "running" : (gamestate->loaded ? "loaded" : "unloaded");
+		const char* policy = PolicyName(r ? r->policy : RESIDENCY_KEEP);
+		struct Arena* arena = gamestate->loaded ? FindArena(game, gamestate->name) : NULL;
+		if (arena) {
+			size_t size = MeasureArena(arena);
+			total += size;
+			PrintConsole(game, "  %s: %s (%s), ~%zu KiB in %d resource(s)", gamestate->name, state, policy, size / 1024, arena->count);
+		} else {
+			PrintConsole(game, "  %s: %s (%s)", gamestate->name, state, policy);
+		}
+	}
+	PrintConsole(game, "  total: ~%zu KiB; bitmap cache: %zu KiB resident", total / 1024, game->data->cache->resident / 1024);
+	PrintMemoryBudgetStats(game);
+}
@@ -0,0 +1,65 @@
+/*! \file residency.h
+ *  \brief Per-gamestate residency policies and memory report.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_RESIDENCY_H
+#define WAKEYWAKEY_RESIDENCY_H
+
+#include <libsuperderpy.h>
+
+enum ResidencyPolicy {
+	RESIDENCY_KEEP, // stays loaded once loaded; the default for gamestates without a policy
+	RESIDENCY_UNLOAD_AFTER_LEAVE,
+	RESIDENCY_PREFETCH_BEFORE_ENTER, // kept as well, but gets its prefetch run ahead of time
+};
+
+struct ResidentGamestate {
+	char* name;
+	enum ResidencyPolicy policy;
+	void (*prefetch)(struct Game* game);
+	bool entered, prefetched, unloading;
+	bool loaded; // as last seen, to report changes
+	struct ResidentGamestate* next;
+};
+
+/*! \brief Decides which gamestates stay loaded, set up from main.c with SetResidency.
+ *
+ * Gamestates are registered in the order the session goes through them. One with
+ * RESIDENCY_UNLOAD_AFTER_LEAVE gets unloaded as soon as it's not running anymore after
+ * having been entered, or once a gamestate registered after it has been entered (so
+ * intros skipped over don't linger either). RESIDENCY_PREFETCH_BEFORE_ENTER runs the given
+ * prefetch function as soon as one of the gamestates registered before it is entered.
+ *
+ * Enforced from GlobalPostLogic, through the engine's own LoadGamestate/UnloadGamestate.
+ * In debug mode (or with F4) the report lists each gamestate together with what its arena
+ * holds.
+ */
+struct Residency {
+	struct ResidentGamestate* gamestates;
+	int unloaded;
+};
+
+struct Residency* CreateResidency(struct Game* game);
+void DestroyResidency(struct Game* game, struct Residency* residency);
+
+void SetResidency(struct Game* game, const char* name, enum ResidencyPolicy policy, void (*prefetch)(struct Game* game));
+void UpdateResidency(struct Game* game);
+void PrintResidencyReport(struct Game* game);
+
+#endif
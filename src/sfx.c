@@ -0,0 +1,213 @@
+/*! \file sfx.c
+ *  \brief Sound effects triggered through a lock-free queue drained by the mixer.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+static void Record(struct SoundEffects* sfx, double latency) {
+	long us = latency * 1000000;
+	atomic_fetch_add_explicit(&sfx->latencySum, us, memory_order_relaxed);
+	atomic_fetch_add_explicit(&sfx->latencyCount, 1, memory_order_relaxed);
+	atomic_store_explicit(&sfx->latencyLast, us, memory_order_relaxed);
+	if (us > atomic_load_explicit(&sfx->latencyMax, memory_order_relaxed)) {
+		atomic_store_explicit(&sfx->latencyMax, us, memory_order_relaxed);
+	}
+}
+
+static ALLEGRO_SAMPLE_INSTANCE* PickVoice(struct SoundEffect* effect, int count) {
+	for (int i = 0; i < count; i++) {
+		int v = (effect->next + i) % count;
+		if (!al_get_sample_instance_playing(effect->voices[v])) {
+			effect->next = (v + 1) % count;
+			return effect->voices[v];
+		}
+	}
+	// all busy; the round robin makes this the one started first
+	ALLEGRO_SAMPLE_INSTANCE* voice = effect->voices[effect->next];
+	effect->next = (effect->next + 1) % count;
+	return voice;
+}
+
+static bool Execute(struct SoundEffects* sfx, struct SfxCommand* command) {
+	// Returns whether the command had any effect, so only those end up in the latency stats.
+	struct SoundEffect* effect = &sfx->effects[command->effect];
+	if (command->generation != atomic_load_explicit(&effect->generation, memory_order_acquire)) {
+		return false; // posted for whatever was loaded into this slot before
+	}
+	int count = atomic_load_explicit(&effect->voiceCount, memory_order_acquire);
+	if (!count) {
+		return false;
+	}
+	switch (command->type) {
+		case SFX_PLAY: {
+			ALLEGRO_SAMPLE_INSTANCE* voice = PickVoice(effect, count);
+			if (!al_get_sample_instance_attached(voice)) {
+				atomic_fetch_add_explicit(&sfx->silent, 1, memory_order_relaxed); // still being decoded
+				return false;
+			}
+			al_stop_sample_instance(voice);
+			al_set_sample_instance_gain(voice, effect->gain);
+			al_play_sample_instance(voice);
+			break;
+		}
+		case SFX_STOP:
+			for (int i = 0; i < count; i++) {
+				al_stop_sample_instance(effect->voices[i]);
+			}
+			break;
+		case SFX_GAIN:
+			effect->gain = command->gain;
+			for (int i = 0; i < count; i++) {
+				al_set_sample_instance_gain(effect->voices[i], effect->gain);
+			}
+			break;
+	}
+	return true;
+}
+
+static void Drain(void* buf, unsigned int samples, void* d) {
+	// Runs on the audio thread with the mixer locked; Allegro's audio mutexes are recursive,
+	// so our own voices can be poked from here. Anything started now gets mixed into the
+	// next fragment, hence the extra fragment in the latency.
+	struct SoundEffects* sfx = d;
+	unsigned int tail = atomic_load_explicit(&sfx->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&sfx->head, memory_order_acquire);
+	if (tail == head) {
+		return;
+	}
+	double now = al_get_time() + samples / (double)sfx->frequency;
+	for (; tail != head; tail++) {
+		struct SfxCommand* command = &sfx->commands[tail % SFX_QUEUE_SIZE];
+		if (Execute(sfx, command)) {
+			Record(sfx, now - command->posted);
+		}
+	}
+	atomic_store_explicit(&sfx->tail, tail, memory_order_release);
+}
+
+struct SoundEffects* CreateSoundEffects(struct Game* game) {
+	struct SoundEffects* sfx = calloc(1, sizeof(struct SoundEffects));
+	sfx->frequency = al_get_mixer_frequency(game->audio.fx);
+	sfx->mixer = al_create_mixer(sfx->frequency, ALLEGRO_AUDIO_DEPTH_FLOAT32, ALLEGRO_CHANNEL_CONF_2);
+	al_attach_mixer_to_mixer(sfx->mixer, game->audio.fx);
+	al_set_mixer_postprocess_callback(sfx->mixer, Drain, sfx);
+	return sfx;
+}
+
+void PrintSoundEffectStats(struct Game* game) {
+	struct SoundEffects* sfx = game->data->sfx;
+	int count = atomic_load(&sfx->latencyCount);
+	int silent = atomic_load(&sfx->silent);
+	if (!count && !sfx->dropped && !silent) {
+		return;
+	}
+	PrintConsole(game, "Sound effects: %d command(s), latency %.2f ms on average, %.2f ms max; %d dropped, %d played before decoded.", count,
+		count ? atomic_load(&sfx->latencySum) / 1000.0 / count : 0.0, atomic_load(&sfx->latencyMax) / 1000.0, sfx->dropped, silent);
+}
+
+void DestroySoundEffects(struct Game* game, struct SoundEffects* sfx) {
+	// unloading needs the callback in place, see UnloadSoundEffect
+	for (int i = 0; i < SFX_MAX_EFFECTS; i++) {
+		if (sfx->effects[i].used) {
+			PrintConsole(game, "Sound effect %d still loaded at exit.", i);
+			UnloadSoundEffect(game, i);
+		}
+	}
+	al_set_mixer_postprocess_callback(sfx->mixer, NULL, NULL);
+	PrintSoundEffectStats(game);
+	al_detach_mixer(sfx->mixer);
+	al_destroy_mixer(sfx->mixer);
+	free(sfx);
+}
+
+int LoadSoundEffect(struct Game* game, const char* path, int voices) {
+	// Returns a handle for the other functions here, or -1 when there's no free slot left.
+	struct SoundEffects* sfx = game->data->sfx;
+	if (voices > SFX_MAX_VOICES) {
+		voices = SFX_MAX_VOICES;
+	}
+	for (int i = 0; i < SFX_MAX_EFFECTS; i++) {
+		struct SoundEffect* effect = &sfx->effects[i];
+		if (effect->used) {
+			continue;
+		}
+		effect->used = true;
+		effect->next = 0;
+		effect->gain = 1.0;
+		for (int v = 0; v < voices; v++) {
+			effect->voices[v] = AcquireSampleInstance(game, path, sfx->mixer);
+			al_set_sample_instance_playmode(effect->voices[v], ALLEGRO_PLAYMODE_ONCE);
+			PinSampleInstance(game, effect->voices[v]); // triggered from the audio thread, can't wait for decoding
+		}
+		atomic_store_explicit(&effect->voiceCount, voices, memory_order_release);
+		return i;
+	}
+	PrintConsole(game, "No free sound effect slot for %s!", path);
+	return -1;
+}
+
+void UnloadSoundEffect(struct Game* game, int effect) {
+	if (effect < 0) {
+		return;
+	}
+	struct SoundEffects* sfx = game->data->sfx;
+	struct SoundEffect* e = &sfx->effects[effect];
+	int count = atomic_exchange(&e->voiceCount, 0);
+	atomic_fetch_add_explicit(&e->generation, 1, memory_order_release);
+	// Drain may have read the count just before, and still be using the voices. Setting the
+	// callback takes the mixer's lock, which Drain runs under, so once it returns nothing
+	// touches them anymore. Detaching alone doesn't do that for voices that aren't attached yet.
+	al_set_mixer_postprocess_callback(sfx->mixer, Drain, sfx);
+	for (int v = 0; v < count; v++) {
+		al_detach_sample_instance(e->voices[v]);
+		ReleaseSampleInstance(game, e->voices[v]);
+		e->voices[v] = NULL;
+	}
+	e->used = false;
+}
+
+static void Post(struct Game* game, struct SfxCommand command) {
+	// Never blocks: if the mixer fell that far behind, the command is just dropped.
+	struct SoundEffects* sfx = game->data->sfx;
+	if (command.effect < 0) {
+		return;
+	}
+	unsigned int head = atomic_load_explicit(&sfx->head, memory_order_relaxed);
+	if (head - atomic_load_explicit(&sfx->tail, memory_order_acquire) == SFX_QUEUE_SIZE) {
+		sfx->dropped++;
+		return;
+	}
+	command.generation = atomic_load_explicit(&sfx->effects[command.effect].generation, memory_order_relaxed);
+	command.posted = al_get_time();
+	sfx->commands[head % SFX_QUEUE_SIZE] = command;
+	atomic_store_explicit(&sfx->head, head + 1, memory_order_release);
+}
+
+void PlaySoundEffect(struct Game* game, int effect) {
+	Post(game, (struct SfxCommand){.type = SFX_PLAY, .effect = effect});
+}
+
+void StopSoundEffect(struct Game* game, int effect) {
+	Post(game, (struct SfxCommand){.type = SFX_STOP, .effect = effect});
+}
+
+void SetSoundEffectGain(struct Game* game, int effect, float gain) {
+	Post(game, (struct SfxCommand){.type = SFX_GAIN, .effect = effect, .gain = gain});
+}
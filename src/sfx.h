@@ -0,0 +1,94 @@
+/*! \file sfx.h
+ *  \brief Sound effects triggered through a lock-free queue drained by the mixer.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_SFX_H
+#define WAKEYWAKEY_SFX_H
+
+#include <libsuperderpy.h>
+#include <stdatomic.h>
+
+#define SFX_QUEUE_SIZE 64 // has to be a power of two
+#define SFX_MAX_EFFECTS 16
+#define SFX_MAX_VOICES 4
+
+enum SfxCommandType {
+	SFX_PLAY,
+	SFX_STOP,
+	SFX_GAIN
+};
+
+struct SfxCommand {
+	enum SfxCommandType type;
+	int effect;
+	float gain;
+	unsigned int generation; // of the effect when it was posted
+	double posted; // al_get_time() when it was posted
+};
+
+struct SoundEffect {
+	bool used; // only touched by the game thread
+	ALLEGRO_SAMPLE_INSTANCE* voices[SFX_MAX_VOICES]; // from the sound registry
+	atomic_int voiceCount; // 0 while (un)loading, so the mixer leaves the voices alone
+	atomic_uint generation; // bumped on unload, so commands still queued for the old effect get dropped
+	// only touched by the mixer
+	int next;
+	float gain;
+};
+
+/*! \brief Plays sound effects from the audio thread, so the game never waits for the mixer's lock.
+ *
+ * The game thread posts commands into a single-producer single-consumer ring; they're
+ * drained by the postprocess callback of a mixer of our own (attached to game->audio.fx),
+ * which is where the voices get started and stopped. Every effect has a small pool of
+ * voices, so a sound triggered again before it ended doesn't cut itself off; when all
+ * of them are busy, the one started first gets restarted.
+ *
+ * The latency between posting a command and its effect being heard (up to the end of
+ * the mixer's fragment it's applied in) is shown in the perf overlay and printed on exit.
+ */
+struct SoundEffects {
+	ALLEGRO_MIXER* mixer;
+	unsigned int frequency;
+
+	struct SfxCommand commands[SFX_QUEUE_SIZE];
+	atomic_uint head; // written by the game thread only
+	atomic_uint tail; // written by the mixer only
+	int dropped; // posted while the queue was full; game thread only
+
+	struct SoundEffect effects[SFX_MAX_EFFECTS];
+
+	// written by the mixer, read by the game thread for the stats
+	atomic_long latencySum, latencyMax, latencyLast; // in microseconds
+	atomic_int latencyCount;
+	atomic_int silent; // plays skipped because the sample wasn't decoded yet; not part of the latency
+};
+
+struct SoundEffects* CreateSoundEffects(struct Game* game);
+void DestroySoundEffects(struct Game* game, struct SoundEffects* sfx);
+void PrintSoundEffectStats(struct Game* game);
+
+int LoadSoundEffect(struct Game* game, const char* path, int voices);
+void UnloadSoundEffect(struct Game* game, int effect);
+
+void PlaySoundEffect(struct Game* game, int effect);
+void StopSoundEffect(struct Game* game, int effect);
+void SetSoundEffectGain(struct Game* game, int effect, float gain);
+
+#endif
@@ -0,0 +1,387 @@
+/*! \file sounds.c
+ *  \brief Shared, refcounted samples decoded in the background.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+static struct SoundEntry* FindByPath(struct SoundRegistry* registry, const char* path) {
+	for (struct SoundEntry* entry = registry->entries; entry; entry = entry->next) {
+		if (strcmp(entry->path, path) == 0) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static struct SoundInstance* FindInstance(struct SoundRegistry* registry, ALLEGRO_SAMPLE_INSTANCE* instance) {
+	for (struct SoundInstance* si = registry->instances; si; si = si->next) {
+		if (si->instance == instance) {
+			return si;
+		}
+	}
+	return NULL;
+}
+
+static void Unref(struct SoundRegistry* registry, struct SoundEntry* entry) {
+	// the registry's mutex has to be held
+	if (--entry->refs > 0) {
+		return;
+	}
+	struct SoundEntry** e = &registry->entries;
+	while (*e != entry) {
+		e = &(*e)->next;
+	}
+	*e = entry->next;
+	if (entry->sample) {
+		al_destroy_sample(entry->sample);
+		registry->resident -= entry->size;
+	}
+	free(entry->path);
+	free(entry->file);
+	free(entry);
+}
+
+static void Finish(struct Game* game, struct SoundRegistry* registry, struct SoundEntry* entry, ALLEGRO_SAMPLE* sample) {
+	// the registry's mutex has to be held
+	if (!sample) {
+		PrintConsole(game, "Could not load %s!", entry->path);
+	} else {
+		entry->size = al_get_sample_length(sample) * al_get_channel_count(al_get_sample_channels(sample)) * al_get_audio_depth_size(al_get_sample_depth(sample));
+		registry->resident += entry->size;
+		if (registry->resident > registry->peak) {
+			registry->peak = registry->resident;
+		}
+	}
+	entry->sample = sample;
+	entry->decoding = false;
+	entry->decoded = true;
+	Unref(registry, entry); // the reference taken for decoding
+}
+
+static ALLEGRO_SAMPLE* Decode(struct SoundEntry* entry) {
+	return entry->packed ? LoadPackedSample(entry->packed) : al_load_sample(entry->file);
+}
+
+static struct SoundEntry* NextQueued(struct SoundRegistry* registry) {
+	for (struct SoundEntry* entry = registry->entries; entry; entry = entry->next) {
+		if (entry->queued) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static void* Worker(ALLEGRO_THREAD* thread, void* d) {
+	struct SoundRegistry* registry = d;
+	al_lock_mutex(registry->mutex);
+	while (!registry->quit) {
+		struct SoundEntry* entry = NextQueued(registry);
+		if (!entry) {
+			al_wait_cond(registry->cond, registry->mutex);
+			continue;
+		}
+		entry->queued = false;
+		entry->decoding = true; // so it doesn't get queued again in the meantime
+		al_unlock_mutex(registry->mutex);
+
+		ALLEGRO_SAMPLE* sample = Decode(entry);
+
+		al_lock_mutex(registry->mutex);
+		Finish(registry->game, registry, entry, sample);
+	}
+	al_unlock_mutex(registry->mutex);
+	return NULL;
+}
+
+struct SoundRegistry* CreateSoundRegistry(struct Game* game) {
+	struct SoundRegistry* registry = calloc(1, sizeof(struct SoundRegistry));
+	registry->game = game;
+	registry->mutex = al_create_mutex();
+	registry->cond = al_create_cond();
+#ifndef LIBSUPERDERPY_SINGLE_THREAD
+	registry->thread = al_create_thread(Worker, registry);
+	al_start_thread(registry->thread);
+#endif
+	return registry;
+}
+
+int CountSampleInstances(struct Game* game) {
+	struct SoundRegistry* registry = game->data->sounds;
+	int count = 0;
+	al_lock_mutex(registry->mutex);
+	for (struct SoundInstance* si = registry->instances; si; si = si->next) {
+		count++;
+	}
+	al_unlock_mutex(registry->mutex);
+	return count;
+}
+
+void PrintSoundStats(struct Game* game) {
+	struct SoundRegistry* registry = game->data->sounds;
+	al_lock_mutex(registry->mutex);
+	PrintConsole(game, "Sound registry: %d hit(s), %d miss(es), %zu bytes resident (peak %zu).", registry->hits, registry->misses, registry->resident, registry->peak);
+	al_unlock_mutex(registry->mutex);
+}
+
+void DestroySoundRegistry(struct Game* game, struct SoundRegistry* registry) {
+	if (registry->thread) {
+		al_lock_mutex(registry->mutex);
+		registry->quit = true;
+		al_broadcast_cond(registry->cond);
+		al_unlock_mutex(registry->mutex);
+		al_join_thread(registry->thread, NULL);
+		al_destroy_thread(registry->thread);
+	}
+	PrintSoundStats(game);
+	struct SoundInstance* si = registry->instances;
+	while (si) {
+		struct SoundInstance* next = si->next;
+		PrintConsole(game, "Sample instance of %s still alive at exit.", si->entry->path);
+		al_destroy_sample_instance(si->instance);
+		free(si);
+		si = next;
+	}
+	struct SoundEntry* entry = registry->entries;
+	while (entry) {
+		struct SoundEntry* next = entry->next;
+		if (entry->sample) {
+			al_destroy_sample(entry->sample);
+		}
+		free(entry->path);
+		free(entry->file);
+		free(entry);
+		entry = next;
+	}
+	al_destroy_cond(registry->cond);
+	al_destroy_mutex(registry->mutex);
+	free(registry);
+}
+
+static bool NeedsDecoding(struct SoundEntry* entry) {
+	// new, or evicted by the memory budget
+	return !entry->decoded && !entry->queued && !entry->decoding;
+}
+
+static void Enqueue(struct Game* game, struct SoundRegistry* registry, struct SoundEntry* entry) {
+	// the registry's mutex has to be held
+	entry->queued = true;
+	entry->refs++; // dropped once decoded
+	if (!registry->thread) {
+		entry->queued = false;
+		Finish(game, registry, entry, Decode(entry));
+	}
+	al_broadcast_cond(registry->cond);
+}
+
+static void Attach(struct SoundInstance* si) {
+	si->attached = true;
+	if (!si->entry->sample) {
+		return; // couldn't be decoded; the instance stays silent
+	}
+	al_set_sample(si->instance, si->entry->sample);
+	al_attach_sample_instance_to_mixer(si->instance, si->mixer);
+	if (si->play) {
+		al_play_sample_instance(si->instance);
+	}
+}
+
+ALLEGRO_SAMPLE_INSTANCE* AcquireSampleInstance(struct Game* game, const char* path, ALLEGRO_MIXER* mixer) {
+	// Returns a new instance of the sample, attached to the mixer once the sample is decoded.
+	// Set it up as usual (playmode, gain...), but play it with PlaySampleInstance and get rid
+	// of it with ReleaseSampleInstance.
+	struct SoundRegistry* registry = game->data->sounds;
+	al_lock_mutex(registry->mutex);
+	struct SoundEntry* entry = FindByPath(registry, path);
+	if (entry) {
+		registry->hits++;
+	} else {
+		registry->misses++;
+		entry = calloc(1, sizeof(struct SoundEntry));
+		entry->path = strdup(path);
+		entry->packed = FindPacked(game, path);
+		if (!entry->packed) {
+			entry->file = strdup(GetDataFilePath(game, path));
+		}
+		// appended, so samples get decoded in the order they were asked for
+		struct SoundEntry** e = &registry->entries;
+		while (*e) {
+			e = &(*e)->next;
+		}
+		*e = entry;
+	}
+	entry->refs++;
+	entry->lastUsed = al_get_time();
+	if (NeedsDecoding(entry)) {
+		Enqueue(game, registry, entry);
+	}
+
+	struct SoundInstance* si = calloc(1, sizeof(struct SoundInstance));
+	si->instance = al_create_sample_instance(NULL);
+	si->mixer = mixer;
+	si->entry = entry;
+	si->next = registry->instances;
+	registry->instances = si;
+	if (entry->decoded) {
+		Attach(si);
+	}
+	al_unlock_mutex(registry->mutex);
+	return si->instance;
+}
+
+void ReleaseSampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance) {
+	struct SoundRegistry* registry = game->data->sounds;
+	al_lock_mutex(registry->mutex);
+	struct SoundInstance** si = &registry->instances;
+	while (*si && (*si)->instance != instance) {
+		si = &(*si)->next;
+	}
+	if (*si) {
+		struct SoundInstance* found = *si;
+		*si = found->next;
+		al_destroy_sample_instance(found->instance);
+		Unref(registry, found->entry);
+		free(found);
+	}
+	al_unlock_mutex(registry->mutex);
+}
+
+bool PlaySampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance) {
+	// Like al_play_sample_instance, except that an instance still waiting for its sample
+	// starts playing once the sample is there.
+	struct SoundRegistry* registry = game->data->sounds;
+	bool ret = true;
+	al_lock_mutex(registry->mutex);
+	struct SoundInstance* si = FindInstance(registry, instance);
+	if (si) {
+		si->entry->lastUsed = al_get_time();
+	}
+	if (si && !si->attached) {
+		si->play = true;
+		if (NeedsDecoding(si->entry)) {
+			Enqueue(game, registry, si->entry);
+			if (si->entry->decoded) {
+				Attach(si);
+			}
+		}
+	} else {
+		ret = al_play_sample_instance(instance);
+	}
+	al_unlock_mutex(registry->mutex);
+	return ret;
+}
+
+void StopSampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance) {
+	struct SoundRegistry* registry = game->data->sounds;
+	al_lock_mutex(registry->mutex);
+	struct SoundInstance* si = FindInstance(registry, instance);
+	if (si) {
+		si->play = false;
+	}
+	al_stop_sample_instance(instance);
+	al_unlock_mutex(registry->mutex);
+}
+
+void PinSampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance) {
+	struct SoundRegistry* registry = game->data->sounds;
+	al_lock_mutex(registry->mutex);
+	struct SoundInstance* si = FindInstance(registry, instance);
+	if (si) {
+		si->entry->pinned = true;
+	}
+	al_unlock_mutex(registry->mutex);
+}
+
+static bool IsPlaying(struct SoundRegistry* registry, struct SoundEntry* entry) {
+	for (struct SoundInstance* si = registry->instances; si; si = si->next) {
+		if (si->entry == entry && si->attached && al_get_sample_instance_playing(si->instance)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+struct SoundEntry* FindLeastRecentSample(struct Game* game, double minAge, double* age) {
+	// Returns the decoded sample that hasn't been used for the longest time (and at least
+	// minAge seconds), or NULL when there's nothing that could be evicted.
+	struct SoundRegistry* registry = game->data->sounds;
+	struct SoundEntry* found = NULL;
+	double now = al_get_time();
+	al_lock_mutex(registry->mutex);
+	for (struct SoundEntry* entry = registry->entries; entry; entry = entry->next) {
+		if (!entry->sample || entry->pinned || now - entry->lastUsed < minAge || IsPlaying(registry, entry)) {
+			continue;
+		}
+		if (!found || entry->lastUsed < found->lastUsed) {
+			found = entry;
+		}
+	}
+	if (found) {
+		*age = now - found->lastUsed;
+	}
+	al_unlock_mutex(registry->mutex);
+	return found;
+}
+
+void EvictSample(struct Game* game, struct SoundEntry* entry) {
+	// Its instances stay valid; they get the sample back once it's decoded again.
+	struct SoundRegistry* registry = game->data->sounds;
+	al_lock_mutex(registry->mutex);
+	for (struct SoundInstance* si = registry->instances; si; si = si->next) {
+		if (si->entry == entry && si->attached) {
+			al_set_sample(si->instance, NULL); // detaches it from its mixer as well
+			si->attached = false;
+			si->play = false;
+		}
+	}
+	al_destroy_sample(entry->sample);
+	entry->sample = NULL;
+	entry->decoded = false;
+	registry->resident -= entry->size;
+	al_unlock_mutex(registry->mutex);
+}
+
+void UpdateSounds(struct Game* game) {
+	// Hands freshly decoded samples over to the instances waiting for them.
+	struct SoundRegistry* registry = game->data->sounds;
+	al_lock_mutex(registry->mutex);
+	for (struct SoundInstance* si = registry->instances; si; si = si->next) {
+		if (!si->attached && si->entry->decoded) {
+			Attach(si);
+		}
+	}
+	al_unlock_mutex(registry->mutex);
+}
+
+ALLEGRO_AUDIO_STREAM* OpenAudioStream(struct Game* game, const char* path, size_t buffers, unsigned int samples) {
+	// Streams are cheap to open, so they're not handled by the registry; only their buffer sizes
+	// can be tuned per asset in the config.
+	const char* value = GetConfigOptionDefault(game, STREAMS_CONFIG_SECTION, path, NULL);
+	if (value) {
+		size_t b;
+		unsigned int s;
+		if (sscanf(value, "%zu %u", &b, &s) == 2 && b && s) {
+			buffers = b;
+			samples = s;
+		} else {
+			PrintConsole(game, "Ignoring invalid stream buffer sizes for %s: %s", path, value);
+		}
+	}
+	return LoadDataAudioStream(game, path, buffers, samples);
+}
@@ -0,0 +1,94 @@
+/*! \file sounds.h
+ *  \brief Shared, refcounted samples decoded in the background.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_SOUNDS_H
+#define WAKEYWAKEY_SOUNDS_H
+
+#include "pack.h"
+#include <libsuperderpy.h>
+
+// [WakeyWakey/streams] <path>=<buffers> <samples> overrides the buffer sizes passed to OpenAudioStream
+#define STREAMS_CONFIG_SECTION GAME_CONFIG_SECTION "/streams"
+
+struct SoundEntry {
+	char* path; // relative to the data directory
+	const struct PackEntry* packed;
+	char* file; // resolved loose file, NULL when packed
+	ALLEGRO_SAMPLE* sample; // NULL until decoded, or when decoding failed
+	bool queued, decoding, decoded;
+	int refs; // one per instance, plus one while queued for decoding
+	size_t size;
+	double lastUsed; // al_get_time() of the last acquire or play, for the memory budget
+	bool pinned; // played from outside of the registry, so it can't be evicted
+	struct SoundEntry* next;
+};
+
+struct SoundInstance {
+	ALLEGRO_SAMPLE_INSTANCE* instance;
+	ALLEGRO_MIXER* mixer;
+	struct SoundEntry* entry;
+	bool attached;
+	bool play; // PlaySampleInstance was called before the sample got decoded
+	struct SoundInstance* next;
+};
+
+/*! \brief Every sample loaded from the data directory, shared between gamestates.
+ *
+ * AcquireSampleInstance returns right away with an instance of the sample, which gets
+ * decoded on a background thread if it isn't resident yet. Such an instance gets its data
+ * and is attached to its mixer from GlobalPostLogic once the sample is there; playing it
+ * with PlaySampleInstance before that starts it as soon as it's ready. A sample is destroyed
+ * as soon as its last instance is released with ReleaseSampleInstance.
+ *
+ * Under memory pressure, the budget may evict a sample that isn't playing; its instances get
+ * detached and the sample is decoded again on the next PlaySampleInstance. Instances played
+ * by other means (like the sound effects' audio thread) have to be pinned with
+ * PinSampleInstance.
+ */
+struct SoundRegistry {
+	struct Game* game;
+	struct SoundEntry* entries; // in the order they got requested, which is also the decoding order
+	struct SoundInstance* instances;
+	ALLEGRO_MUTEX* mutex;
+	ALLEGRO_COND* cond;
+	ALLEGRO_THREAD* thread; // NULL in single-threaded builds, where decoding happens right away
+	bool quit;
+	int hits, misses;
+	size_t resident, peak;
+};
+
+struct SoundRegistry* CreateSoundRegistry(struct Game* game);
+void DestroySoundRegistry(struct Game* game, struct SoundRegistry* registry);
+void UpdateSounds(struct Game* game);
+void PrintSoundStats(struct Game* game);
+int CountSampleInstances(struct Game* game);
+
+ALLEGRO_SAMPLE_INSTANCE* AcquireSampleInstance(struct Game* game, const char* path, ALLEGRO_MIXER* mixer);
+void ReleaseSampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance);
+bool PlaySampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance);
+void StopSampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance);
+void PinSampleInstance(struct Game* game, ALLEGRO_SAMPLE_INSTANCE* instance);
+
+struct SoundEntry* FindLeastRecentSample(struct Game* game, double minAge, double* age);
+void EvictSample(struct Game* game, struct SoundEntry* entry);
+
+ALLEGRO_AUDIO_STREAM* OpenAudioStream(struct Game* game, const char* path, size_t buffers, unsigned int samples);
+
+#endif
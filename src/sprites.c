@@ -0,0 +1,273 @@
+/*! \file sprites.c
+ *  \brief Spritesheet definitions compiled by tools/spritec.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#include <math.h>
+
+static uint32_t ReadU32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float ReadFloat(const unsigned char* p) {
+	uint32_t bits = ReadU32(p);
+	float value;
+	memcpy(&value, &bits, sizeof(float));
+	return value;
+}
+
+static char* ReadManifest(struct Game* game, size_t* size) {
+	// one read, into memory that stays around for as long as the manifest does
+	const struct PackEntry* entry = FindPacked(game, "sprites/manifest.bin");
+	ALLEGRO_FILE* file = NULL;
+	if (entry) {
+		file = OpenPacked(entry);
+	} else {
+		char* filename = FindDataFilePath(game, "sprites/manifest.bin");
+		file = filename ? al_fopen(filename, "rb") : NULL;
+	}
+	if (!file) {
+		return NULL;
+	}
+	*size = al_fsize(file);
+	char* data = malloc(*size + 1);
+	if (al_fread(file, data, *size) != *size) {
+		free(data);
+		data = NULL;
+	}
+	al_fclose(file);
+	return data;
+}
+
+static bool ParseManifest(struct SpriteManifest* manifest, size_t size) {
+	const unsigned char* p = (unsigned char*)manifest->data;
+	if (size < SPRITES_HEADER_SIZE || memcmp(p, SPRITES_MAGIC, sizeof(SPRITES_MAGIC)) != 0) {
+		return false;
+	}
+	manifest->characterCount = ReadU32(p + 8);
+	manifest->sheetCount = ReadU32(p + 12);
+	manifest->frameCount = ReadU32(p + 16);
+	size_t stringsSize = ReadU32(p + 20);
+	size_t tables = (size_t)manifest->characterCount * SPRITES_CHARACTER_SIZE + (size_t)manifest->sheetCount * SPRITES_SHEET_SIZE +
+		(size_t)manifest->frameCount * SPRITES_FRAME_SIZE;
+	if (SPRITES_HEADER_SIZE + tables + stringsSize != size || !stringsSize) {
+		return false;
+	}
+	const char* strings = manifest->data + SPRITES_HEADER_SIZE + tables;
+	manifest->data[size] = 0; // in case the last string isn't terminated
+
+	manifest->characters = calloc(manifest->characterCount, sizeof(struct ManifestCharacter));
+	manifest->sheets = calloc(manifest->sheetCount, sizeof(struct ManifestSheet));
+	manifest->frames = calloc(manifest->frameCount, sizeof(struct ManifestFrame));
+	p += SPRITES_HEADER_SIZE;
+	for (int i = 0; i < manifest->characterCount; i++, p += SPRITES_CHARACTER_SIZE) {
+		struct ManifestCharacter* c = &manifest->characters[i];
+		*c = (struct ManifestCharacter){.name = strings + ReadU32(p), .firstSheet = ReadU32(p + 4), .sheetCount = ReadU32(p + 8)};
+		if (ReadU32(p) >= stringsSize || c->firstSheet < 0 || c->sheetCount < 0 || c->firstSheet + c->sheetCount > manifest->sheetCount) {
+			return false;
+		}
+	}
+	for (int i = 0; i < manifest->sheetCount; i++, p += SPRITES_SHEET_SIZE) {
+		struct ManifestSheet* s = &manifest->sheets[i];
+		*s = (struct ManifestSheet){.name = strings + ReadU32(p), .firstFrame = ReadU32(p + 4), .frameCount = ReadU32(p + 8),
+			.duration = ReadFloat(p + 12), .pivotX = ReadFloat(p + 16), .pivotY = ReadFloat(p + 20),
+			.successor = (int32_t)ReadU32(p + 24), .bidir = ReadU32(p + 28) & SPRITES_FLAG_BIDIR};
+		if (ReadU32(p) >= stringsSize || s->firstFrame < 0 || s->frameCount < 0 || s->firstFrame + s->frameCount > manifest->frameCount ||
+			s->successor < -1 || s->successor >= manifest->sheetCount) {
+			return false;
+		}
+	}
+	for (int i = 0; i < manifest->frameCount; i++, p += SPRITES_FRAME_SIZE) {
+		if (ReadU32(p) >= stringsSize) {
+			return false;
+		}
+		manifest->frames[i] = (struct ManifestFrame){.file = strings + ReadU32(p), .duration = ReadFloat(p + 4)};
+	}
+	return true;
+}
+
+struct SpriteManifest* LoadSpriteManifest(struct Game* game) {
+	if (!strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "sprite_manifest", "1"), NULL, 10)) {
+		PrintConsole(game, "Sprite manifest disabled, reading spritesheet INIs.");
+		return NULL;
+	}
+	size_t size;
+	struct SpriteManifest* manifest = calloc(1, sizeof(struct SpriteManifest));
+	manifest->data = ReadManifest(game, &size);
+	if (!manifest->data) {
+		PrintConsole(game, "No sprite manifest, reading spritesheet INIs.");
+		DestroySpriteManifest(manifest);
+		return NULL;
+	}
+	if (!ParseManifest(manifest, size)) {
+		PrintConsole(game, "Sprite manifest is broken, reading spritesheet INIs.");
+		DestroySpriteManifest(manifest);
+		return NULL;
+	}
+	PrintConsole(game, "Sprite manifest: %d characters, %d spritesheets, %d frames.", manifest->characterCount, manifest->sheetCount, manifest->frameCount);
+	return manifest;
+}
+
+void DestroySpriteManifest(struct SpriteManifest* manifest) {
+	if (!manifest) {
+		return;
+	}
+	free(manifest->characters);
+	free(manifest->sheets);
+	free(manifest->frames);
+	free(manifest->data);
+	free(manifest);
+}
+
+static int CompareCharacter(const void* key, const void* c) {
+	return strcmp(key, ((const struct ManifestCharacter*)c)->name);
+}
+
+static int CompareSheet(const void* key, const void* s) {
+	return strcmp(key, ((const struct ManifestSheet*)s)->name);
+}
+
+static struct ManifestSheet* FindSheet(struct SpriteManifest* manifest, const char* character, const char* name) {
+	if (!manifest || manifest->mismatch) {
+		return NULL;
+	}
+	struct ManifestCharacter* c = bsearch(character, manifest->characters, manifest->characterCount, sizeof(struct ManifestCharacter), CompareCharacter);
+	if (!c) {
+		return NULL;
+	}
+	return bsearch(name, manifest->sheets + c->firstSheet, c->sheetCount, sizeof(struct ManifestSheet), CompareSheet);
+}
+
+static bool Same(double a, double b) {
+	// the manifest stores floats, the engine keeps what it parsed from the INI
+	return fabs(a - b) <= 1e-5 * fmax(1.0, fabs(b));
+}
+
+static bool CompareSpritesheets(struct Game* game, struct Spritesheet* compiled, struct Spritesheet* engine) {
+	// Every field the manifest fills is compared by value. Everything else is compared byte by
+	// byte, so a field of the engine's that isn't known here (and so stays zeroed in the compiled
+	// one) shows up as soon as the engine gives it anything else by default.
+	bool ok = compiled->frameCount == engine->frameCount && Same(compiled->duration, engine->duration) &&
+		Same(compiled->pivotX, engine->pivotX) && Same(compiled->pivotY, engine->pivotY) && compiled->bidir == engine->bidir &&
+		!compiled->successor == !engine->successor && (!engine->successor || strcmp(compiled->successor, engine->successor) == 0);
+	if (!ok) {
+		PrintConsole(game, "Sprite manifest: %s differs from its INI.", engine->name);
+		return false;
+	}
+	struct Spritesheet rest = *compiled;
+	rest.name = engine->name;
+	rest.frameCount = engine->frameCount;
+	rest.duration = engine->duration;
+	rest.pivotX = engine->pivotX;
+	rest.pivotY = engine->pivotY;
+	rest.bidir = engine->bidir;
+	rest.successor = engine->successor;
+	rest.frames = engine->frames;
+	rest.next = engine->next;
+	if (memcmp(&rest, engine, sizeof(struct Spritesheet)) != 0) {
+		PrintConsole(game, "Sprite manifest: %s has spritesheet fields the manifest doesn't set.", engine->name);
+		return false;
+	}
+	for (int i = 0; i < engine->frameCount; i++) {
+		struct SpritesheetFrame frame = compiled->frames[i];
+		if (strcmp(frame.file, engine->frames[i].file) != 0 || !Same(frame.duration, engine->frames[i].duration)) {
+			PrintConsole(game, "Sprite manifest: frame %d of %s differs from its INI.", i, engine->name);
+			return false;
+		}
+		frame.file = engine->frames[i].file;
+		frame.duration = engine->frames[i].duration;
+		if (memcmp(&frame, &engine->frames[i], sizeof(struct SpritesheetFrame)) != 0) {
+			PrintConsole(game, "Sprite manifest: %s has frame fields the manifest doesn't set.", engine->name);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void CheckManifest(struct Game* game, struct Character* character, struct Spritesheet* compiled) {
+	// In debug mode, the first compiled spritesheet also gets registered by the engine from its
+	// INI. If the two don't match, the manifest is set aside and the INIs are used from then on.
+	struct SpriteManifest* manifest = game->data->sprites;
+	manifest->checked = true;
+	struct Character* reference = CreateCharacter(game, character->name);
+	RegisterSpritesheet(game, reference, compiled->name);
+	struct Spritesheet* engine = reference->spritesheets;
+	while (engine && strcmp(engine->name, compiled->name) != 0) {
+		engine = engine->next;
+	}
+	manifest->mismatch = !engine || !CompareSpritesheets(game, compiled, engine);
+	if (manifest->mismatch) {
+		PrintConsole(game, "Sprite manifest doesn't match the engine's %s/%s, reading spritesheet INIs.", character->name, compiled->name);
+	} else {
+		PrintConsole(game, "Sprite manifest matches the engine's %s/%s.", character->name, compiled->name);
+	}
+	DestroyCharacter(game, reference);
+}
+
+static void FreeSpritesheet(struct Spritesheet* s) {
+	for (int i = 0; i < s->frameCount; i++) {
+		free(s->frames[i].file);
+	}
+	free(s->frames);
+	free(s->successor);
+	free(s->name);
+	free(s);
+}
+
+void RegisterCompiledSpritesheet(struct Game* game, struct Character* character, const char* name) {
+	// Drop-in replacement for RegisterSpritesheet. Builds the spritesheet the same way the engine
+	// does when reading the INI, except that everything has been parsed and checked already.
+	struct ManifestSheet* sheet = FindSheet(game->data->sprites, character->name, name);
+	if (!sheet) {
+		RegisterSpritesheet(game, character, (char*)name);
+		return;
+	}
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		if (strcmp(s->name, name) == 0) {
+			return;
+		}
+	}
+	struct Spritesheet* s = calloc(1, sizeof(struct Spritesheet));
+	s->name = strdup(name);
+	s->frameCount = sheet->frameCount;
+	s->duration = sheet->duration;
+	s->bidir = sheet->bidir;
+	s->pivotX = sheet->pivotX;
+	s->pivotY = sheet->pivotY;
+	if (sheet->successor >= 0) {
+		s->successor = strdup(game->data->sprites->sheets[sheet->successor].name);
+	}
+	s->frames = calloc(s->frameCount, sizeof(struct SpritesheetFrame));
+	for (int i = 0; i < s->frameCount; i++) {
+		struct ManifestFrame* frame = &game->data->sprites->frames[sheet->firstFrame + i];
+		s->frames[i].file = strdup(frame->file);
+		s->frames[i].duration = frame->duration;
+	}
+	if (game->config.debug && !game->data->sprites->checked) {
+		CheckManifest(game, character, s);
+		if (game->data->sprites->mismatch) {
+			FreeSpritesheet(s);
+			RegisterSpritesheet(game, character, (char*)name);
+			return;
+		}
+	}
+	s->next = character->spritesheets;
+	character->spritesheets = s;
+}
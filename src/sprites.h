@@ -0,0 +1,83 @@
+/*! \file sprites.h
+ *  \brief Spritesheet definitions compiled by tools/spritec.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_SPRITES_H
+#define WAKEYWAKEY_SPRITES_H
+
+#include <libsuperderpy.h>
+
+// sprites/manifest.bin layout (little endian), as written by tools/spritec.c:
+//   "WWSPR1\0\0", uint32 character count, uint32 spritesheet count, uint32 frame count, uint32 string table size
+//   characters: {uint32 name, uint32 first spritesheet, uint32 spritesheet count}, sorted by name
+//   spritesheets: {uint32 name, uint32 first frame, uint32 frame count, float duration,
+//                  float pivot x, float pivot y, int32 successor (spritesheet index or -1), uint32 flags}
+//                 sorted by name within each character
+//   frames: {uint32 file, float duration}
+//   string table, names are offsets into it
+#define SPRITES_MAGIC "WWSPR1"
+#define SPRITES_HEADER_SIZE 24
+#define SPRITES_CHARACTER_SIZE 12
+#define SPRITES_SHEET_SIZE 32
+#define SPRITES_FRAME_SIZE 8
+#define SPRITES_FLAG_BIDIR 1
+
+struct ManifestFrame {
+	const char* file;
+	float duration;
+};
+
+struct ManifestSheet {
+	const char* name;
+	int firstFrame, frameCount;
+	float duration, pivotX, pivotY;
+	int successor;
+	bool bidir;
+};
+
+struct ManifestCharacter {
+	const char* name;
+	int firstSheet, sheetCount;
+};
+
+/*! \brief All spritesheet INIs, parsed at build time.
+ *
+ * Spritesheets that use anything the compiler doesn't understand are left out of it,
+ * as are spritesheets added after the build, so those still get read from their INIs
+ * by the engine. [WakeyWakey] sprite_manifest=0 ignores the manifest altogether, for
+ * editing the INIs without rebuilding.
+ *
+ * The spritesheets are built by hand rather than by the engine, so in debug mode the first
+ * one is compared against the engine's own; on any difference the manifest goes unused.
+ */
+struct SpriteManifest {
+	char* data;
+	struct ManifestCharacter* characters;
+	struct ManifestSheet* sheets;
+	struct ManifestFrame* frames;
+	int characterCount, sheetCount, frameCount;
+	bool checked, mismatch; // see CheckManifest in sprites.c
+};
+
+struct SpriteManifest* LoadSpriteManifest(struct Game* game);
+void DestroySpriteManifest(struct SpriteManifest* manifest);
+
+void RegisterCompiledSpritesheet(struct Game* game, struct Character* character, const char* name);
+
+#endif
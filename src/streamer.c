@@ -0,0 +1,339 @@
+/*! \file streamer.c
+ *  \brief Loads spritesheets on demand and evicts them when unused.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+static int AddSource(struct StreamedSheet* sheet, const char* path) {
+	for (int i = 0; i < sheet->sourceCount; i++) {
+		if (strcmp(sheet->sources[i], path) == 0) {
+			return i;
+		}
+	}
+	sheet->sources = realloc(sheet->sources, sizeof(char*) * (sheet->sourceCount + 1));
+	sheet->sources[sheet->sourceCount] = strdup(path);
+	return sheet->sourceCount++;
+}
+
+static bool SetupSheet(struct Game* game, struct StreamedSheet* sheet, struct Spritesheet* s, struct Atlas* atlas, const char* name) {
+	sheet->name = strdup(s->name);
+	sheet->frameCount = s->frameCount;
+	sheet->frames = calloc(s->frameCount, sizeof(struct StreamedFrame));
+	for (int i = 0; i < s->frameCount; i++) {
+		if (!s->frames[i].file) {
+			return false;
+		}
+		struct StreamedFrame* frame = &sheet->frames[i];
+		int page;
+		if (atlas && GetAtlasRect(atlas, s->frames[i].file, &page, &frame->x, &frame->y, &frame->w, &frame->h)) {
+			const char* path = GetAtlasPagePath(atlas, page);
+			if (path) {
+				frame->source = AddSource(sheet, path);
+				continue;
+			}
+		}
+		char path[255];
+		snprintf(path, 255, "sprites/%s/%s", name, s->frames[i].file);
+		*frame = (struct StreamedFrame){.source = AddSource(sheet, path)};
+	}
+	sheet->bitmaps = calloc(sheet->sourceCount, sizeof(ALLEGRO_BITMAP*));
+	return true;
+}
+
+struct SheetStreamer* CreateSheetStreamer(struct Game* game, struct Character* reference, double evictAfter) {
+	// Only the frame layout is taken from the reference character; it's not touched otherwise.
+	// Returns NULL when some spritesheet isn't made of per-frame files, as those can only be
+	// loaded by the engine all at once.
+	struct SheetStreamer* streamer = calloc(1, sizeof(struct SheetStreamer));
+	streamer->game = game;
+	streamer->evictAfter = evictAfter;
+	for (struct Spritesheet* s = reference->spritesheets; s; s = s->next) {
+		streamer->sheetCount++;
+	}
+	streamer->sheets = calloc(streamer->sheetCount, sizeof(struct StreamedSheet));
+
+	// with an atlas, frames point into its pages; sheets sharing a page keep it resident together
+	struct Atlas* atlas = OpenAtlas(game, reference->name);
+	bool ok = true;
+	int i = 0;
+	for (struct Spritesheet* s = reference->spritesheets; s; s = s->next) {
+		if (!SetupSheet(game, &streamer->sheets[i++], s, atlas, reference->name)) {
+			PrintConsole(game, "Spritesheet %s of %s isn't made of frame files, can't stream it.", s->name, reference->name);
+			ok = false;
+			break;
+		}
+	}
+	DestroyAtlas(game, atlas);
+
+	if (!ok) {
+		streamer->sheetCount = i;
+		DestroySheetStreamer(game, streamer);
+		return NULL;
+	}
+	streamer->next = game->data->streamers;
+	game->data->streamers = streamer;
+	return streamer;
+}
+
+static struct StreamedSheet* FindSheet(struct SheetStreamer* streamer, const char* name) {
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		if (strcmp(streamer->sheets[i].name, name) == 0) {
+			return &streamer->sheets[i];
+		}
+	}
+	return NULL;
+}
+
+static struct Spritesheet* FindSpritesheet(struct Character* character, const char* name) {
+	for (struct Spritesheet* s = character->spritesheets; s; s = s->next) {
+		if (strcmp(s->name, name) == 0) {
+			return s;
+		}
+	}
+	return NULL;
+}
+
+static void ApplySheet(struct SheetStreamer* streamer, struct StreamedSheet* sheet, struct Character* character) {
+	struct Spritesheet* s = FindSpritesheet(character, sheet->name);
+	if (!s || s->frameCount != sheet->frameCount) {
+		return;
+	}
+	for (int i = 0; i < sheet->frameCount; i++) {
+		struct StreamedFrame* frame = &sheet->frames[i];
+		ALLEGRO_BITMAP* source = sheet->bitmaps[frame->source];
+		if (!source) {
+			continue;
+		}
+		int w = frame->w ? frame->w : al_get_bitmap_width(source);
+		int h = frame->w ? frame->h : al_get_bitmap_height(source);
+		s->frames[i].bitmap = al_create_sub_bitmap(source, frame->x, frame->y, w, h);
+		RetainBitmap(streamer->game, source);
+		if (i == 0) {
+			s->width = w;
+			s->height = h;
+		}
+	}
+}
+
+static void UnapplySheet(struct SheetStreamer* streamer, struct StreamedSheet* sheet, struct Character* character) {
+	struct Spritesheet* s = FindSpritesheet(character, sheet->name);
+	if (!s) {
+		return;
+	}
+	for (int i = 0; i < s->frameCount; i++) {
+		if (!s->frames[i].bitmap) {
+			continue;
+		}
+		ALLEGRO_BITMAP* parent = al_get_parent_bitmap(s->frames[i].bitmap);
+		// sub-bitmaps have to go before their parents
+		al_destroy_bitmap(s->frames[i].bitmap);
+		s->frames[i].bitmap = NULL;
+		ReleaseBitmap(streamer->game, parent);
+	}
+}
+
+static void ReleaseSources(struct SheetStreamer* streamer, struct StreamedSheet* sheet) {
+	for (int i = 0; i < sheet->sourceCount; i++) {
+		ReleaseBitmap(streamer->game, sheet->bitmaps[i]);
+		sheet->bitmaps[i] = NULL;
+	}
+	sheet->state = SHEET_UNLOADED;
+}
+
+static void EvictSheet(struct SheetStreamer* streamer, struct StreamedSheet* sheet) {
+	for (int c = 0; c < streamer->characterCount; c++) {
+		UnapplySheet(streamer, sheet, streamer->characters[c]);
+	}
+	ReleaseSources(streamer, sheet);
+	streamer->evictions++;
+}
+
+void AddStreamedCharacter(struct SheetStreamer* streamer, struct Character* character) {
+	if (!streamer) {
+		return;
+	}
+	if (streamer->characterCount == streamer->characterCapacity) {
+		streamer->characterCapacity = streamer->characterCapacity ? streamer->characterCapacity * 2 : 16;
+		streamer->characters = realloc(streamer->characters, sizeof(struct Character*) * streamer->characterCapacity);
+	}
+	streamer->characters[streamer->characterCount++] = character;
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		if (streamer->sheets[i].state == SHEET_RESIDENT) {
+			ApplySheet(streamer, &streamer->sheets[i], character);
+		}
+	}
+}
+
+static void StartBatch(struct SheetStreamer* streamer) {
+	// Everything requested in the meantime goes out as a single batch, so the worker threads
+	// are spun up once per batch rather than once per sheet.
+	struct AssetLoader* loader = NULL;
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		struct StreamedSheet* sheet = &streamer->sheets[i];
+		if (sheet->state != SHEET_QUEUED) {
+			continue;
+		}
+		if (!loader) {
+			loader = CreateAssetLoader(streamer->game);
+		}
+		for (int j = 0; j < sheet->sourceCount; j++) {
+			QueueBitmap(loader, &sheet->bitmaps[j], sheet->sources[j], 0);
+		}
+		sheet->state = SHEET_LOADING;
+		streamer->loads++;
+	}
+	if (loader) {
+		StartAssetLoader(loader);
+		streamer->loader = loader;
+	}
+}
+
+static void FinishBatch(struct SheetStreamer* streamer) {
+	UploadAssets(streamer->loader);
+	streamer->loader = NULL;
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		struct StreamedSheet* sheet = &streamer->sheets[i];
+		if (sheet->state != SHEET_LOADING) {
+			continue;
+		}
+		for (int c = 0; c < streamer->characterCount; c++) {
+			ApplySheet(streamer, sheet, streamer->characters[c]);
+		}
+		sheet->state = SHEET_RESIDENT;
+		sheet->lastUsed = streamer->time;
+	}
+}
+
+bool RequestSheet(struct SheetStreamer* streamer, const char* name) {
+	// Marks the sheet as used and starts loading it if it isn't there yet.
+	// Returns whether it's resident already.
+	if (!streamer) {
+		return true;
+	}
+	struct StreamedSheet* sheet = FindSheet(streamer, name);
+	if (!sheet) {
+		return true; // not ours
+	}
+	sheet->lastUsed = streamer->time;
+	if (sheet->state == SHEET_UNLOADED) {
+		sheet->state = SHEET_QUEUED;
+		if (!streamer->loader) {
+			StartBatch(streamer);
+		}
+	}
+	return sheet->state == SHEET_RESIDENT;
+}
+
+bool IsSheetResident(struct SheetStreamer* streamer, const char* name) {
+	if (!streamer) {
+		return true;
+	}
+	struct StreamedSheet* sheet = FindSheet(streamer, name);
+	return !sheet || sheet->state == SHEET_RESIDENT;
+}
+
+void UpdateSheetStreamer(struct SheetStreamer* streamer, double delta) {
+	// Call from the logic handler; results are uploaded here, so it has to run on the main thread.
+	if (!streamer) {
+		return;
+	}
+	streamer->time += delta;
+	if (streamer->loader && PollAssetLoader(streamer->loader)) {
+		FinishBatch(streamer);
+	}
+	if (!streamer->loader) {
+		StartBatch(streamer);
+	}
+	if (streamer->evictAfter <= 0.0) {
+		return;
+	}
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		struct StreamedSheet* sheet = &streamer->sheets[i];
+		if (sheet->state == SHEET_RESIDENT && streamer->time - sheet->lastUsed > streamer->evictAfter) {
+			EvictSheet(streamer, sheet);
+		}
+	}
+}
+
+int FindLeastRecentSheet(struct SheetStreamer* streamer, double minAge, double* age) {
+	// Returns the index of the resident sheet that hasn't been requested for the longest time
+	// (and at least minAge seconds of logic time), or -1 when there's none.
+	int found = -1;
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		struct StreamedSheet* sheet = &streamer->sheets[i];
+		if (sheet->state != SHEET_RESIDENT || streamer->time - sheet->lastUsed < minAge) {
+			continue;
+		}
+		if (found < 0 || sheet->lastUsed < streamer->sheets[found].lastUsed) {
+			found = i;
+		}
+	}
+	if (found >= 0) {
+		*age = streamer->time - streamer->sheets[found].lastUsed;
+	}
+	return found;
+}
+
+void EvictStreamedSheet(struct SheetStreamer* streamer, int sheet) {
+	if (streamer->sheets[sheet].state == SHEET_RESIDENT) {
+		EvictSheet(streamer, &streamer->sheets[sheet]);
+	}
+}
+
+void DestroySheetStreamer(struct Game* game, struct SheetStreamer* streamer) {
+	// Takes the streamed frames away from the characters, so destroy it before them.
+	if (!streamer) {
+		return;
+	}
+	for (struct SheetStreamer** s = &game->data->streamers; *s; s = &(*s)->next) {
+		if (*s == streamer) {
+			*s = streamer->next;
+			break;
+		}
+	}
+	if (streamer->loader) {
+		// the results are still in memory bitmaps; no point in uploading them now
+		DestroyAssetLoader(streamer->loader);
+		streamer->loader = NULL;
+	}
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		struct StreamedSheet* sheet = &streamer->sheets[i];
+		if (sheet->state == SHEET_RESIDENT) {
+			EvictSheet(streamer, sheet);
+		} else if (sheet->state == SHEET_LOADING) {
+			ReleaseSources(streamer, sheet);
+		}
+	}
+	if (streamer->loads) {
+		PrintConsole(game, "Streamed %d spritesheet(s), evicted %d.", streamer->loads, streamer->evictions);
+	}
+	for (int i = 0; i < streamer->sheetCount; i++) {
+		for (int j = 0; j < streamer->sheets[i].sourceCount; j++) {
+			free(streamer->sheets[i].sources[j]);
+		}
+		free(streamer->sheets[i].sources);
+		free(streamer->sheets[i].bitmaps);
+		free(streamer->sheets[i].frames);
+		free(streamer->sheets[i].name);
+	}
+	free(streamer->sheets);
+	free(streamer->characters);
+	free(streamer);
+}
@@ -0,0 +1,89 @@
+/*! \file streamer.h
+ *  \brief Loads spritesheets on demand and evicts them when unused.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_STREAMER_H
+#define WAKEYWAKEY_STREAMER_H
+
+#include "loader.h"
+#include <libsuperderpy.h>
+
+enum SheetState {
+	SHEET_UNLOADED,
+	SHEET_QUEUED, // requested while another batch was in flight
+	SHEET_LOADING,
+	SHEET_RESIDENT
+};
+
+struct StreamedFrame {
+	int source;
+	int x, y, w, h; // w == 0 means the whole source bitmap
+};
+
+struct StreamedSheet {
+	char* name;
+	int frameCount;
+	struct StreamedFrame* frames;
+	int sourceCount;
+	char** sources; // atlas pages or loose frame files, relative to the data directory
+	ALLEGRO_BITMAP** bitmaps; // each one holds a cache reference while loading or resident
+	enum SheetState state;
+	double lastUsed;
+};
+
+/*! \brief Keeps the spritesheets of a group of identical characters resident only while they're needed.
+ *
+ * All characters added to a streamer must have the same per-frame spritesheets registered
+ * as the reference character it was created from (and nothing loaded). RequestSheet starts
+ * decoding a sheet in the background and marks it as used; once it's done, UpdateSheetStreamer
+ * fills the frames of every character with sub-bitmaps holding a reference to their source,
+ * just like LoadCharacterSpritesheets does. Sheets not requested for evictAfter seconds
+ * (of logic time) get their frames taken away again.
+ *
+ * The memory budget may evict the least recently requested sheets earlier than that; they
+ * are loaded again on the next request, like any other.
+ *
+ * A NULL streamer behaves as if every sheet was always resident.
+ */
+struct SheetStreamer {
+	struct Game* game;
+	struct StreamedSheet* sheets;
+	int sheetCount;
+	struct Character** characters;
+	int characterCount, characterCapacity;
+
+	struct AssetLoader* loader; // batch in flight, if any
+	double time, evictAfter;
+	int loads, evictions;
+
+	struct SheetStreamer* next; // live streamers are linked in CommonResources for the memory budget
+};
+
+struct SheetStreamer* CreateSheetStreamer(struct Game* game, struct Character* reference, double evictAfter);
+void DestroySheetStreamer(struct Game* game, struct SheetStreamer* streamer);
+
+void AddStreamedCharacter(struct SheetStreamer* streamer, struct Character* character);
+bool RequestSheet(struct SheetStreamer* streamer, const char* name);
+bool IsSheetResident(struct SheetStreamer* streamer, const char* name);
+void UpdateSheetStreamer(struct SheetStreamer* streamer, double delta);
+
+int FindLeastRecentSheet(struct SheetStreamer* streamer, double minAge, double* age);
+void EvictStreamedSheet(struct SheetStreamer* streamer, int sheet);
+
+#endif
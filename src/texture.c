@@ -0,0 +1,145 @@
+/*! \file texture.c
+ *  \brief Pre-decoded, premultiplied textures produced by tools/texconv.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+static uint32_t ReadU32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool IsCurrent(const char* image, const char* texture) {
+	ALLEGRO_FS_ENTRY* src = al_create_fs_entry(image);
+	ALLEGRO_FS_ENTRY* tex = al_create_fs_entry(texture);
+	bool current = !al_fs_entry_exists(src) || al_get_fs_entry_mtime(src) <= al_get_fs_entry_mtime(tex);
+	al_destroy_fs_entry(src);
+	al_destroy_fs_entry(tex);
+	return current;
+}
+
+bool FindTexture(struct Game* game, const char* image, struct TextureSource* source) {
+	*source = (struct TextureSource){0};
+	if (!game->data->textures || (al_get_new_bitmap_flags() & ALLEGRO_NO_PREMULTIPLIED_ALPHA)) {
+		return false;
+	}
+	char path[255];
+	const char* ext = strrchr(image, '.');
+	snprintf(path, 255, "%.*s.tex", ext ? (int)(ext - image) : (int)strlen(image), image);
+
+	// the pack gets built from the same tree as the textures in it, so they can't be stale
+	source->packed = FindPacked(game, path);
+	if (source->packed) {
+		return true;
+	}
+	char* filename = FindDataFilePath(game, path);
+	if (!filename) {
+		return false;
+	}
+	source->path = strdup(filename);
+	filename = FindDataFilePath(game, image);
+	if (filename && !IsCurrent(filename, source->path)) {
+		PrintConsole(game, "%s is older than %s, ignoring it.", path, image);
+		ReleaseTextureSource(source);
+		return false;
+	}
+	return true;
+}
+
+void ReleaseTextureSource(struct TextureSource* source) {
+	free(source->path);
+	source->path = NULL;
+}
+
+static bool Decode(ALLEGRO_FILE* file, ALLEGRO_LOCKED_REGION* region, int width, int height, int encoding, uint32_t size) {
+	if (encoding == TEX_ENCODING_RAW) {
+		if (size != (uint32_t)width * height * 4) {
+			return false;
+		}
+		for (int y = 0; y < height; y++) {
+			if (al_fread(file, (char*)region->data + y * region->pitch, width * 4) != (size_t)width * 4) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// runs can span several rows
+	int x = 0, y = 0;
+	while (y < height) {
+		unsigned char token[4];
+		if (al_fread(file, token, 4) != 4) {
+			return false;
+		}
+		uint32_t count = ReadU32(token) & 0x7fffffff;
+		bool repeat = token[3] & 0x80;
+		uint32_t pixel = 0;
+		if (repeat && al_fread(file, &pixel, 4) != 4) {
+			return false;
+		}
+		while (count) {
+			if (y >= height) {
+				return false;
+			}
+			uint32_t* row = (uint32_t*)((char*)region->data + y * region->pitch);
+			uint32_t n = count < (uint32_t)(width - x) ? count : (uint32_t)(width - x);
+			if (repeat) {
+				for (uint32_t i = 0; i < n; i++) {
+					row[x + i] = pixel;
+				}
+			} else if (al_fread(file, row + x, n * 4) != n * 4) {
+				return false;
+			}
+			count -= n;
+			x += n;
+			if (x == width) {
+				x = 0;
+				y++;
+			}
+		}
+	}
+	return true;
+}
+
+ALLEGRO_BITMAP* LoadTexture(struct TextureSource* source) {
+	ALLEGRO_FILE* file = source->packed ? OpenPacked(source->packed) : al_fopen(source->path, "rb");
+	if (!file) {
+		return NULL;
+	}
+	unsigned char header[TEX_HEADER_SIZE];
+	ALLEGRO_BITMAP* bitmap = NULL;
+	if (al_fread(file, header, TEX_HEADER_SIZE) == TEX_HEADER_SIZE && memcmp(header, TEX_MAGIC, sizeof(TEX_MAGIC)) == 0) {
+		bitmap = al_create_bitmap(ReadU32(header + 8), ReadU32(header + 12));
+	}
+	if (bitmap) {
+		// the pixels are already premultiplied, just like Allegro's own loaders would leave them;
+		// for video bitmaps unlocking uploads them straight to the texture
+		ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+		bool ok = region && Decode(file, region, al_get_bitmap_width(bitmap), al_get_bitmap_height(bitmap), ReadU32(header + 16), ReadU32(header + 20));
+		if (region) {
+			al_unlock_bitmap(bitmap);
+		}
+		if (!ok) {
+			al_destroy_bitmap(bitmap);
+			bitmap = NULL;
+		}
+	}
+	al_fclose(file);
+	return bitmap;
+}
@@ -0,0 +1,52 @@
+/*! \file texture.h
+ *  \brief Pre-decoded, premultiplied textures produced by tools/texconv.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_TEXTURE_H
+#define WAKEYWAKEY_TEXTURE_H
+
+#include <libsuperderpy.h>
+
+// File layout (little endian), as written by tools/texconv.c:
+//   "WWTEX1\0\0", uint32 width, uint32 height, uint32 encoding, uint32 payload size in bytes
+//   payload: premultiplied RGBA, 8 bits per channel, rows top to bottom, no padding
+// With TEX_ENCODING_RLE the pixels are split into runs, each starting with an uint32:
+// the top bit set means that the following pixel repeats (value & 0x7fffffff) times,
+// otherwise that many pixels follow verbatim.
+#define TEX_MAGIC "WWTEX1"
+#define TEX_HEADER_SIZE 24
+#define TEX_ENCODING_RAW 0
+#define TEX_ENCODING_RLE 1
+
+/*! \brief Where the .tex file for an image is, as found by FindTexture.
+ *
+ * foo.png gets converted into foo.tex next to it. A loose .tex is only used when it's
+ * not older than the image it was made from, and only for bitmaps with premultiplied
+ * alpha; in any other case the original image gets decoded as usual.
+ */
+struct TextureSource {
+	const struct PackEntry* packed;
+	char* path; // when loose
+};
+
+bool FindTexture(struct Game* game, const char* image, struct TextureSource* source);
+ALLEGRO_BITMAP* LoadTexture(struct TextureSource* source); // safe to call from the loader's workers
+void ReleaseTextureSource(struct TextureSource* source);
+
+#endif
@@ -0,0 +1,103 @@
+/*! \file throttle.c
+ *  \brief Lowers the frame rate while nothing happens on the screen.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+struct FrameThrottle* CreateThrottle(struct Game* game) {
+	struct FrameThrottle* throttle = calloc(1, sizeof(struct FrameThrottle));
+	throttle->idleAfter = strtod(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "idle_after", "30"), NULL);
+	throttle->idleFps = strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "idle_fps", "10"), NULL, 10);
+	throttle->pauseHidden = strtol(GetConfigOptionDefault(game, GAME_CONFIG_SECTION, "pause_hidden", "1"), NULL, 10);
+	throttle->lastActivity = al_get_time();
+	return throttle;
+}
+
+void DestroyThrottle(struct Game* game, struct FrameThrottle* throttle) {
+	free(throttle);
+}
+
+static void Wake(struct Game* game, struct FrameThrottle* throttle) {
+	throttle->lastActivity = al_get_time();
+	if (throttle->idle) {
+		throttle->idle = false;
+		al_set_timer_speed(game->_priv.timer, throttle->speed);
+	}
+}
+
+void AllowIdle(struct Game* game) {
+	game->data->throttle->allowIdle = true;
+}
+
+void ThrottleEvent(struct Game* game, ALLEGRO_EVENT* ev) {
+	struct FrameThrottle* throttle = game->data->throttle;
+	switch (ev->type) {
+		case ALLEGRO_EVENT_DISPLAY_SWITCH_OUT:
+		case ALLEGRO_EVENT_DISPLAY_HALT_DRAWING:
+			if (throttle->pauseHidden && !throttle->hidden) {
+				throttle->hidden = true;
+				al_stop_timer(game->_priv.timer);
+				PrintConsole(game, "Display hidden, rendering stopped.");
+			}
+			break;
+		case ALLEGRO_EVENT_DISPLAY_SWITCH_IN:
+		case ALLEGRO_EVENT_DISPLAY_RESUME_DRAWING:
+			if (throttle->hidden) {
+				throttle->hidden = false;
+				al_resume_timer(game->_priv.timer);
+				PrintConsole(game, "Display visible, rendering resumed.");
+			}
+			Wake(game, throttle);
+			break;
+		case ALLEGRO_EVENT_KEY_DOWN:
+		case ALLEGRO_EVENT_KEY_CHAR:
+		case ALLEGRO_EVENT_MOUSE_AXES:
+		case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN:
+		case ALLEGRO_EVENT_TOUCH_BEGIN:
+		case ALLEGRO_EVENT_TOUCH_MOVE:
+		case ALLEGRO_EVENT_JOYSTICK_AXIS:
+		case ALLEGRO_EVENT_JOYSTICK_BUTTON_DOWN:
+		case ALLEGRO_EVENT_DISPLAY_EXPOSE:
+		case ALLEGRO_EVENT_DISPLAY_RESIZE:
+			Wake(game, throttle);
+			break;
+		default:
+			break;
+	}
+}
+
+void UpdateThrottle(struct Game* game) {
+	// called after every logic tick
+	struct FrameThrottle* throttle = game->data->throttle;
+	if (!throttle->speed) {
+		// the timer doesn't exist yet when CreateThrottle gets called
+		throttle->speed = al_get_timer_speed(game->_priv.timer);
+	}
+	if (!throttle->allowIdle) {
+		Wake(game, throttle);
+		return;
+	}
+	throttle->allowIdle = false;
+	if (!throttle->idle && throttle->idleFps > 0 && al_get_time() - throttle->lastActivity >= throttle->idleAfter) {
+		throttle->idle = true;
+		al_set_timer_speed(game->_priv.timer, 1.0 / throttle->idleFps);
+		PrintConsole(game, "Idle for %.0f seconds, going down to %d FPS.", throttle->idleAfter, throttle->idleFps);
+	}
+}
@@ -0,0 +1,52 @@
+/*! \file throttle.h
+ *  \brief Lowers the frame rate while nothing happens on the screen.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_THROTTLE_H
+#define WAKEYWAKEY_THROTTLE_H
+
+#include <libsuperderpy.h>
+
+/*! \brief Slows down the engine's frame timer when the game is idle or can't be seen.
+ *
+ * A gamestate that's only waiting for input calls AllowIdle from its logic. Once that
+ * has been the case for [WakeyWakey] idle_after seconds without any input, frames are
+ * ticked at idle_fps instead of the full rate, until the next input event or the first
+ * logic tick without AllowIdle. On display switch-out or halted drawing the timer is
+ * stopped altogether (unless pause_hidden is 0) and restarted on the way back.
+ */
+struct FrameThrottle {
+	double speed; // timer speed at full rate, as set up by the engine
+	double idleAfter;
+	int idleFps;
+	bool pauseHidden;
+
+	double lastActivity;
+	bool allowIdle; // set by AllowIdle since the last logic tick
+	bool idle, hidden;
+};
+
+struct FrameThrottle* CreateThrottle(struct Game* game);
+void DestroyThrottle(struct Game* game, struct FrameThrottle* throttle);
+
+void AllowIdle(struct Game* game);
+void ThrottleEvent(struct Game* game, ALLEGRO_EVENT* ev);
+void UpdateThrottle(struct Game* game);
+
+#endif
@@ -0,0 +1,198 @@
+/*! \file tweens.c
+ *  \brief Batched tweens stored as structure of arrays.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#include <math.h>
+
+struct TweenBatch* CreateTweenBatch(int count, bool lut) {
+	struct TweenBatch* batch = calloc(1, sizeof(struct TweenBatch));
+	batch->count = count;
+	batch->useLUT = lut;
+	batch->start = calloc(count, sizeof(float));
+	batch->stop = calloc(count, sizeof(float));
+	batch->duration = calloc(count, sizeof(float));
+	batch->pos = calloc(count, sizeof(float));
+	batch->progress = calloc(count, sizeof(float));
+	batch->value = calloc(count, sizeof(float));
+	batch->eased = calloc(count, sizeof(float));
+	batch->style = calloc(count, sizeof(unsigned char));
+	batch->running = calloc(count, sizeof(unsigned char));
+	for (int i = 0; i < count; i++) {
+		SetStaticTween(batch, i, 0.0);
+	}
+	return batch;
+}
+
+void DestroyTweenBatch(struct TweenBatch* batch) {
+	for (int i = 0; i < TWEEN_MAX_STYLES; i++) {
+		free(batch->lut[i]);
+	}
+	free(batch->start);
+	free(batch->stop);
+	free(batch->duration);
+	free(batch->pos);
+	free(batch->progress);
+	free(batch->value);
+	free(batch->eased);
+	free(batch->style);
+	free(batch->running);
+	free(batch);
+}
+
+static void BuildLUT(struct TweenBatch* batch, enum TWEEN_STYLE style) {
+	batch->lut[style] = malloc(sizeof(float) * (TWEEN_LUT_SIZE + 1));
+	for (int i = 0; i <= TWEEN_LUT_SIZE; i++) {
+		batch->lut[style][i] = Interpolate(i / (double)TWEEN_LUT_SIZE, style);
+	}
+}
+
+void SetTween(struct TweenBatch* batch, int i, float start, float stop, enum TWEEN_STYLE style, float duration) {
+	batch->start[i] = start;
+	batch->stop[i] = stop;
+	batch->duration[i] = duration;
+	batch->style[i] = style;
+	batch->pos[i] = 0;
+	batch->running[i] = 1;
+	// a zero-length tween is finished right away, like in the engine
+	batch->progress[i] = duration > 0 ? 0 : 1;
+	batch->value[i] = duration > 0 ? start : stop;
+	batch->styles |= 1ull << style;
+	if (batch->useLUT && !batch->lut[style]) {
+		BuildLUT(batch, style);
+	}
+}
+
+void SetStaticTween(struct TweenBatch* batch, int i, float value) {
+	SetTween(batch, i, value, value, TWEEN_STYLE_LINEAR, 0);
+}
+
+void CopyTween(struct TweenBatch* batch, int dst, int src) {
+	batch->start[dst] = batch->start[src];
+	batch->stop[dst] = batch->stop[src];
+	batch->duration[dst] = batch->duration[src];
+	batch->pos[dst] = batch->pos[src];
+	batch->progress[dst] = batch->progress[src];
+	batch->value[dst] = batch->value[src];
+	batch->style[dst] = batch->style[src];
+	batch->running[dst] = batch->running[src];
+}
+
+void PauseTween(struct TweenBatch* batch, int i) {
+	batch->running[i] = 0;
+}
+
+// Easing kernels for the styles used in the game, same formulas as the engine.
+// Each one runs over the whole batch and only keeps results for its own style, so the
+// loops have no branches and the polynomial ones get vectorized.
+
+static inline float QuarticInOut(float p) {
+	float f = p - 1;
+	return p < 0.5f ? 8 * p * p * p * p : -8 * f * f * f * f + 1;
+}
+
+static inline float QuinticOut(float p) {
+	float f = p - 1;
+	return f * f * f * f * f + 1;
+}
+
+static inline float BackInOut(float p) {
+	float f = p < 0.5f ? 2 * p : 1 - (2 * p - 1);
+	float g = f * f * f - f * sinf(f * (float)M_PI);
+	return p < 0.5f ? 0.5f * g : 0.5f * (1 - g) + 0.5f;
+}
+
+static inline float ElasticOut(float p) {
+	return sinf(-13 * (float)M_PI_2 * (p + 1)) * exp2f(-10 * p) + 1;
+}
+
+static inline float SineInOut(float p) {
+	return 0.5f * (1 - cosf(p * (float)M_PI));
+}
+
+#define KERNEL(STYLE, EXPR) \
+	if (batch->styles & (1ull << (STYLE))) { \
+		for (int i = 0; i < n; i++) { \
+			float p = progress[i]; \
+			float e = (EXPR); \
+			eased[i] = (style[i] == (STYLE)) ? e : eased[i]; \
+		} \
+		handled |= 1ull << (STYLE); \
+	}
+
+static void Ease(struct TweenBatch* batch, float* restrict eased) {
+	const float* restrict progress = batch->progress;
+	const unsigned char* restrict style = batch->style;
+	int n = batch->count;
+	unsigned long long handled = 0;
+
+	if (batch->useLUT) {
+		for (int i = 0; i < n; i++) {
+			const float* lut = batch->lut[style[i]];
+			float x = progress[i] * TWEEN_LUT_SIZE;
+			int j = x < TWEEN_LUT_SIZE ? (int)x : TWEEN_LUT_SIZE - 1;
+			eased[i] = lut[j] + (lut[j + 1] - lut[j]) * (x - j);
+		}
+		return;
+	}
+
+	KERNEL(TWEEN_STYLE_LINEAR, p)
+	KERNEL(TWEEN_STYLE_QUARTIC_IN_OUT, QuarticInOut(p))
+	KERNEL(TWEEN_STYLE_QUINTIC_OUT, QuinticOut(p))
+	KERNEL(TWEEN_STYLE_BACK_IN_OUT, BackInOut(p))
+	KERNEL(TWEEN_STYLE_ELASTIC_OUT, ElasticOut(p))
+	KERNEL(TWEEN_STYLE_SINE_IN_OUT, SineInOut(p))
+
+	if (batch->styles & ~handled) {
+		// anything else goes through the engine, one at a time
+		for (int i = 0; i < n; i++) {
+			if (!(handled & (1ull << style[i]))) {
+				eased[i] = Interpolate(progress[i], style[i]);
+			}
+		}
+	}
+}
+
+#undef KERNEL
+
+void UpdateTweens(struct TweenBatch* batch, double delta) {
+	float* restrict pos = batch->pos;
+	float* restrict progress = batch->progress;
+	const float* restrict duration = batch->duration;
+	const unsigned char* restrict running = batch->running;
+	int n = batch->count;
+	float d = delta;
+
+	for (int i = 0; i < n; i++) {
+		float p = fminf(pos[i] + (running[i] ? d : 0), duration[i]);
+		pos[i] = p;
+		progress[i] = duration[i] > 0 ? p / duration[i] : 1;
+	}
+
+	float* restrict eased = batch->eased;
+	Ease(batch, eased);
+
+	const float* restrict start = batch->start;
+	const float* restrict stop = batch->stop;
+	float* restrict value = batch->value;
+	for (int i = 0; i < n; i++) {
+		value[i] = start[i] + (stop[i] - start[i]) * eased[i];
+	}
+}
@@ -0,0 +1,69 @@
+/*! \file tweens.h
+ *  \brief Batched tweens stored as structure of arrays.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAKEYWAKEY_TWEENS_H
+#define WAKEYWAKEY_TWEENS_H
+
+#include <libsuperderpy.h>
+
+#define TWEEN_LUT_SIZE 256
+#define TWEEN_MAX_STYLES 64
+
+/*! \brief A fixed set of tweens advanced together.
+ *
+ * Same semantics as libsuperderpy's Tween/UpdateTween/GetTweenValue, but every field is
+ * kept in its own contiguous array and UpdateTweens advances and evaluates all running
+ * tweens in one pass, one easing kernel at a time. Values are computed once per update,
+ * so reading them is just an array access.
+ *
+ * With lookup tables enabled, easing is interpolated from TWEEN_LUT_SIZE samples taken
+ * from the engine's Interpolate instead of being evaluated (tools/tweenbench prints the
+ * error).
+ * Tweens are referred to by their index; there's no callback support.
+ */
+struct TweenBatch {
+	int count;
+	float *start, *stop, *duration, *pos;
+	float *progress, *value;
+	float* eased; // scratch space for UpdateTweens
+	unsigned char *style, *running;
+	unsigned long long styles; // bitmask of the styles that have been used
+	bool useLUT;
+	float* lut[TWEEN_MAX_STYLES]; // TWEEN_LUT_SIZE + 1 samples, built when a style is first used
+};
+
+struct TweenBatch* CreateTweenBatch(int count, bool lut);
+void DestroyTweenBatch(struct TweenBatch* batch);
+
+void SetTween(struct TweenBatch* batch, int i, float start, float stop, enum TWEEN_STYLE style, float duration);
+void SetStaticTween(struct TweenBatch* batch, int i, float value);
+void CopyTween(struct TweenBatch* batch, int dst, int src);
+void PauseTween(struct TweenBatch* batch, int i);
+void UpdateTweens(struct TweenBatch* batch, double delta);
+
+static inline float GetBatchTweenValue(struct TweenBatch* batch, int i) {
+	return batch->value[i];
+}
+
+static inline float GetBatchTweenPosition(struct TweenBatch* batch, int i) {
+	return batch->progress[i];
+}
+
+#endif
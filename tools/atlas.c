@@ -0,0 +1,261 @@
+/*! \file atlas.c
+ *  \brief Build-time texture atlas packer for character spritesheets.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: atlas <character source dir> <output dir> [max page size]
+//
+// Reads every spritesheet INI in the character directory, collects the frame
+// files they reference (each unique file is packed only once, even if several
+// spritesheets use it) and packs them into as few pages as possible. The pages
+// are written as atlasN.png next to an atlas.ini manifest that maps each frame
+// file to its page and sub-rectangle. A character with a frame that can't be
+// loaded gets no atlas (and no atlas.ini) at all; that's only a warning.
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PADDING 2
+
+struct Frame {
+	char* file;
+	ALLEGRO_BITMAP* bitmap;
+	int page, x, y, w, h;
+};
+
+static struct Frame* frames = NULL;
+static int frameCount = 0, frameCapacity = 0;
+
+static void AddFrame(const char* file) {
+	for (int i = 0; i < frameCount; i++) {
+		if (strcmp(frames[i].file, file) == 0) {
+			return;
+		}
+	}
+	if (frameCount == frameCapacity) {
+		frameCapacity = frameCapacity ? frameCapacity * 2 : 32;
+		frames = realloc(frames, sizeof(struct Frame) * frameCapacity);
+	}
+	frames[frameCount++] = (struct Frame){.file = strdup(file)};
+}
+
+static bool ReadSpritesheet(const char* path) {
+	ALLEGRO_CONFIG* config = al_load_config_file(path);
+	if (!config) {
+		fprintf(stderr, "atlas: could not read %s\n", path);
+		return false;
+	}
+	const char* count = al_get_config_value(config, "animation", "frames");
+	int n = count ? strtol(count, NULL, 10) : 0;
+	for (int i = 0; i < n; i++) {
+		char section[32];
+		snprintf(section, 32, "frame%d", i);
+		const char* file = al_get_config_value(config, section, "file");
+		if (file) {
+			AddFrame(file);
+		}
+	}
+	al_destroy_config(config);
+	return true;
+}
+
+static int CompareHeight(const void* a, const void* b) {
+	const struct Frame* f1 = a;
+	const struct Frame* f2 = b;
+	if (f1->h != f2->h) {
+		return f2->h - f1->h;
+	}
+	return strcmp(f1->file, f2->file);
+}
+
+// Simple shelf packer; frames of a single character tend to share the same size,
+// so this ends up as a tight grid in practice.
+static int Pack(int size, int* widths, int* heights) {
+	int page = 0, x = PADDING, y = PADDING, shelf = 0;
+	widths[0] = 0;
+	heights[0] = 0;
+	for (int i = 0; i < frameCount; i++) {
+		struct Frame* frame = &frames[i];
+		if (frame->w + PADDING * 2 > size || frame->h + PADDING * 2 > size) {
+			fprintf(stderr, "atlas: %s (%dx%d) does not fit on a %dx%d page\n", frame->file, frame->w, frame->h, size, size);
+			return -1;
+		}
+		if (x + frame->w + PADDING > size) {
+			x = PADDING;
+			y += shelf + PADDING;
+			shelf = 0;
+		}
+		if (y + frame->h + PADDING > size) {
+			page++;
+			x = PADDING;
+			y = PADDING;
+			shelf = 0;
+			widths[page] = 0;
+			heights[page] = 0;
+		}
+		frame->page = page;
+		frame->x = x;
+		frame->y = y;
+		x += frame->w + PADDING;
+		if (frame->h > shelf) {
+			shelf = frame->h;
+		}
+		if (x > widths[page]) {
+			widths[page] = x;
+		}
+		if (y + frame->h + PADDING > heights[page]) {
+			heights[page] = y + frame->h + PADDING;
+		}
+	}
+	return page + 1;
+}
+
+static void Skip(const char* output, int loaded) {
+	for (int i = 0; i < loaded; i++) {
+		al_destroy_bitmap(frames[i].bitmap);
+	}
+	for (int i = 0; i < frameCount; i++) {
+		free(frames[i].file);
+	}
+	free(frames);
+	// the output directory is still expected by the steps that follow; an atlas.ini left over
+	// from an earlier build would point at frames that are no longer there
+	al_make_directory(output);
+	ALLEGRO_PATH* path = al_create_path_for_directory(output);
+	al_set_path_filename(path, "atlas.ini");
+	al_remove_filename(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+	al_destroy_path(path);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <character dir> <output dir> [max page size]\n", argv[0]);
+		return 1;
+	}
+	int size = argc > 3 ? strtol(argv[3], NULL, 10) : 2048;
+
+	if (!al_init() || !al_init_image_addon()) {
+		fprintf(stderr, "atlas: could not initialize Allegro\n");
+		return 1;
+	}
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP | ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+
+	ALLEGRO_FS_ENTRY* dir = al_create_fs_entry(argv[1]);
+	if (!al_open_directory(dir)) {
+		fprintf(stderr, "atlas: could not open %s\n", argv[1]);
+		return 1;
+	}
+	ALLEGRO_FS_ENTRY* entry;
+	while ((entry = al_read_directory(dir))) {
+		ALLEGRO_PATH* path = al_create_path(al_get_fs_entry_name(entry));
+		if (strcmp(al_get_path_extension(path), ".ini") == 0 && strcmp(al_get_path_filename(path), "atlas.ini") != 0) {
+			if (!ReadSpritesheet(al_get_fs_entry_name(entry))) {
+				return 1;
+			}
+		}
+		al_destroy_path(path);
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+	al_destroy_fs_entry(dir);
+
+	for (int i = 0; i < frameCount; i++) {
+		ALLEGRO_PATH* path = al_create_path_for_directory(argv[1]);
+		al_set_path_filename(path, frames[i].file);
+		frames[i].bitmap = al_load_bitmap(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+		if (!frames[i].bitmap) {
+			// The game falls back to loose frames when there's no atlas, so a missing frame
+			// only costs this character its atlas instead of failing the whole build.
+			fprintf(stderr, "atlas: warning: could not load %s, skipping %s\n", al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), argv[1]);
+			al_destroy_path(path);
+			Skip(argv[2], i);
+			return 0;
+		}
+		al_destroy_path(path);
+		frames[i].w = al_get_bitmap_width(frames[i].bitmap);
+		frames[i].h = al_get_bitmap_height(frames[i].bitmap);
+	}
+	qsort(frames, frameCount, sizeof(struct Frame), CompareHeight);
+
+	int* widths = calloc(frameCount + 1, sizeof(int));
+	int* heights = calloc(frameCount + 1, sizeof(int));
+	int pages = Pack(size, widths, heights);
+	if (pages < 0) {
+		return 1;
+	}
+
+	al_make_directory(argv[2]);
+	ALLEGRO_CONFIG* manifest = al_create_config();
+	char value[32];
+	snprintf(value, 32, "%d", pages);
+	al_set_config_value(manifest, "atlas", "pages", value);
+
+	for (int p = 0; p < pages; p++) {
+		ALLEGRO_BITMAP* page = al_create_bitmap(widths[p], heights[p]);
+		al_set_target_bitmap(page);
+		al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+		al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+		for (int i = 0; i < frameCount; i++) {
+			if (frames[i].page == p) {
+				al_draw_bitmap(frames[i].bitmap, frames[i].x, frames[i].y, 0);
+			}
+		}
+		char key[32], name[32];
+		snprintf(key, 32, "page%d", p);
+		snprintf(name, 32, "atlas%d.png", p);
+		al_set_config_value(manifest, "atlas", key, name);
+
+		ALLEGRO_PATH* path = al_create_path_for_directory(argv[2]);
+		al_set_path_filename(path, name);
+		if (!al_save_bitmap(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), page)) {
+			fprintf(stderr, "atlas: could not write %s\n", al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+			return 1;
+		}
+		al_destroy_path(path);
+		al_destroy_bitmap(page);
+	}
+
+	for (int i = 0; i < frameCount; i++) {
+		struct {
+			const char* key;
+			int value;
+		} fields[] = {{"page", frames[i].page}, {"x", frames[i].x}, {"y", frames[i].y}, {"w", frames[i].w}, {"h", frames[i].h}};
+		for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+			snprintf(value, 32, "%d", fields[f].value);
+			al_set_config_value(manifest, frames[i].file, fields[f].key, value);
+		}
+		al_destroy_bitmap(frames[i].bitmap);
+		free(frames[i].file);
+	}
+
+	ALLEGRO_PATH* path = al_create_path_for_directory(argv[2]);
+	al_set_path_filename(path, "atlas.ini");
+	bool ok = al_save_config_file(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), manifest);
+	al_destroy_path(path);
+	al_destroy_config(manifest);
+
+	printf("atlas: packed %d frames from %s into %d page(s)\n", frameCount, argv[1], pages);
+
+	free(widths);
+	free(heights);
+	free(frames);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,515 @@
+/*! \file balance.c
+ *  \brief Monte-Carlo simulator for the board and dream rules.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: balance [-g games] [-t threads] [-p players] [-s seed] [-m 1|2|random]
+//
+// Replays the turn logic of gamestates/board.c (NextTurn, ApplyDream, PerformSleeping,
+// WakeUp, Snort, MoveDreamsUp) without any timing or drawing, so the rules can be
+// measured over millions of games. The timeline is modelled as a plain FIFO of actions,
+// which is all the ordering the game relies on. -m picks how players move: always one
+// field, always two, or a coin flip (default).
+//
+// Every game gets its own random stream (the same one the game uses, see src/random.h)
+// seeded from the base seed and the game's index, so the results don't depend on the number
+// of threads.
+//
+// Keep this in sync with board.c when changing the rules.
+
+#include "../src/random.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define COLS 6
+#define ROWS 8
+#define FIELDS (COLS * ROWS)
+#define GEESE 3
+#define MAX_PLAYERS 6
+#define MAX_ROUNDS 256 // games still going after that many sleeping cutscenes count as stuck
+#define MAX_MOVES 4096 // same for moves; a player can get caught between "play twice" and "go back" forever
+#define QUEUE_SIZE 64
+
+enum Action {
+	ACTION_DREAM, // EnlargeDream, ShrinkDream and ApplyDream
+	ACTION_START_TURN,
+	ACTION_START_GAME,
+	ACTION_SLEEP, // WakeUp + WaitForGeeseToSettle + Snort + MoveDreamsUp
+};
+
+enum Policy {
+	POLICY_ONE,
+	POLICY_TWO,
+	POLICY_RANDOM,
+};
+
+struct Field {
+	bool good;
+	int id; // like in the game, it's left behind when the dream moves away
+};
+
+struct Player {
+	int position, selected;
+	bool skipped, twice, beginning;
+};
+
+struct Sim {
+	struct Random rng;
+	enum Policy policy;
+	int playerCount;
+
+	struct Field board[FIELDS + 1]; // the extra one stands for anything past the end
+	uint64_t dreamy; // one bit per field; cheaper to move around than the fields themselves
+	struct Player players[MAX_PLAYERS];
+	int geese[GEESE];
+	struct Player* current;
+	bool active, started, cutscene, indream, ended;
+
+	enum Action queue[QUEUE_SIZE];
+	int head, tail;
+
+	int rounds, moves;
+	uint64_t dreams[2][6]; // [good][id]
+};
+
+struct Stats {
+	uint64_t games, stuck, ties, moves;
+	uint64_t wins[MAX_PLAYERS];
+	uint64_t rounds[MAX_ROUNDS + 1];
+	uint64_t dreams[2][6];
+};
+
+struct Worker {
+	pthread_t thread;
+	uint64_t seed, first, count;
+	enum Policy policy;
+	int players;
+	struct Stats stats;
+};
+
+static struct Field* FieldAt(struct Sim* sim, int position) {
+	// the game indexes past the board when a dream pushes someone beyond the last field
+	return &sim->board[position < FIELDS ? position : FIELDS];
+}
+
+static bool IsDreamy(struct Sim* sim, int position) {
+	return position < FIELDS && (sim->dreamy >> position) & 1;
+}
+
+static void Push(struct Sim* sim, enum Action action) {
+	sim->queue[sim->tail] = action;
+	sim->tail = (sim->tail + 1) % QUEUE_SIZE;
+}
+
+static void NextTurn(struct Sim* sim);
+
+static void PerformSleeping(struct Sim* sim) {
+	for (int i = 0; i < sim->playerCount; i++) {
+		if (sim->players[i].position >= COLS * (ROWS - 1)) {
+			sim->ended = true;
+		}
+	}
+	sim->active = false;
+	sim->cutscene = true;
+	if (sim->ended) {
+		return;
+	}
+	Push(sim, ACTION_SLEEP);
+	Push(sim, sim->started ? ACTION_START_TURN : ACTION_START_GAME);
+}
+
+static void Sleep(struct Sim* sim) {
+	sim->rounds++;
+	// WakeUp
+	for (int i = 0; i < GEESE; i++) {
+		int desired;
+		do {
+			desired = RandomInt(&sim->rng, COLS);
+		} while (desired == sim->geese[i]);
+		sim->geese[i] = desired;
+	}
+	// Snort
+	for (int i = 0; i < GEESE; i++) {
+		static const int good[] = {2, 3, 4}, bad[] = {1, 4, 5};
+		int pos = (ROWS - 1) * COLS + (COLS - 1 - sim->geese[i]);
+		struct Field* field = &sim->board[pos];
+		sim->dreamy |= 1ull << pos;
+		field->good = RandomInt(&sim->rng, 2);
+		field->id = field->good ? good[RandomInt(&sim->rng, 3)] : bad[RandomInt(&sim->rng, 3)];
+	}
+	// MoveDreamsUp; dreams only ever move to lower fields, so going through them
+	// from the bottom overwrites only what has already been moved
+	uint64_t moved = 0;
+	for (uint64_t dreams = sim->dreamy; dreams; dreams &= dreams - 1) {
+		int i = __builtin_ctzll(dreams);
+		if (i >= COLS) {
+			int target = i - (i % COLS) * 2 - 1;
+			sim->board[target] = sim->board[i];
+			moved |= 1ull << target;
+		}
+	}
+	sim->dreamy = moved;
+}
+
+static void ApplyDream(struct Sim* sim) {
+	struct Player* player = sim->current;
+	struct Field* field = FieldAt(sim, player->position);
+	sim->dreams[field->good][field->id]++;
+	switch (field->id) {
+		case 1:
+			player->selected = player->position - 5;
+			if (player->selected < 0) {
+				player->selected = 0;
+			}
+			break;
+		case 2:
+			player->selected = player->position + 5;
+			break;
+		case 3:
+			player->twice = true;
+			break;
+		case 4:
+			if (field->good) {
+				for (int i = 0; i < sim->playerCount; i++) {
+					if (&sim->players[i] != player) {
+						sim->players[i].skipped = true;
+					}
+				}
+			} else {
+				player->skipped = true;
+				NextTurn(sim);
+			}
+			break;
+		case 5:
+			player->selected = 0;
+			break;
+	}
+	// the game looks at the current player's field again once the dream is done,
+	// which may be somebody else by now
+	player = sim->current;
+	field = FieldAt(sim, player->position);
+	if (field->id == 1 || field->id == 2 || field->id == 5) {
+		player->position = player->selected;
+		player->selected++;
+	}
+}
+
+static void NextTurn(struct Sim* sim) {
+	int id = sim->current - sim->players;
+
+	sim->active = true;
+
+	if (sim->current->beginning) {
+		sim->current->beginning = false;
+		return;
+	}
+
+	if (IsDreamy(sim, sim->current->position) && !sim->indream && !sim->cutscene && !sim->current->twice) {
+		sim->indream = true;
+		sim->active = false;
+		sim->current->beginning = false;
+		Push(sim, ACTION_DREAM);
+		Push(sim, ACTION_START_TURN);
+		return;
+	}
+	sim->indream = false;
+
+	if (!sim->cutscene) {
+		bool doCutscene = false, skipped;
+		if (!sim->current->twice) {
+			do {
+				id++;
+				if (id >= sim->playerCount) {
+					id -= sim->playerCount;
+					doCutscene = true;
+				}
+				skipped = sim->players[id].skipped;
+				sim->players[id].skipped = false;
+			} while (skipped);
+		}
+		sim->current->twice = false;
+
+		sim->current = &sim->players[id];
+		if (doCutscene) {
+			PerformSleeping(sim);
+			return;
+		}
+	}
+	sim->cutscene = false;
+	sim->active = true;
+
+	if (IsDreamy(sim, sim->current->position)) {
+		sim->active = false;
+		sim->current->beginning = true;
+		Push(sim, ACTION_DREAM);
+		Push(sim, ACTION_START_TURN);
+	}
+}
+
+static void Move(struct Sim* sim) {
+	// LEFT/RIGHT toggle between one and two fields, SPACE confirms; see EndTura
+	struct Player* player = sim->current;
+	bool two = sim->policy == POLICY_TWO || (sim->policy == POLICY_RANDOM && RandomInt(&sim->rng, 2));
+	if (two) {
+		player->selected = player->position + 2;
+	}
+	sim->active = false;
+	sim->moves++;
+	player->position = player->selected;
+	player->selected++;
+	NextTurn(sim);
+}
+
+static void Play(struct Sim* sim, uint64_t seed) {
+	enum Policy policy = sim->policy;
+	int players = sim->playerCount;
+	memset(sim, 0, sizeof(struct Sim));
+	SeedRandom(&sim->rng, seed);
+	sim->policy = policy;
+	sim->playerCount = players;
+
+	for (int i = 0; i < GEESE; i++) {
+		sim->geese[i] = RandomInt(&sim->rng, COLS);
+	}
+	for (int i = 0; i < players; i++) {
+		sim->players[i].selected = 1;
+	}
+	sim->current = &sim->players[0];
+
+	PerformSleeping(sim); // the first SPACE press
+	while (!sim->ended && sim->rounds <= MAX_ROUNDS && sim->moves <= MAX_MOVES) {
+		if (sim->head != sim->tail) {
+			enum Action action = sim->queue[sim->head];
+			sim->head = (sim->head + 1) % QUEUE_SIZE;
+			switch (action) {
+				case ACTION_DREAM:
+					ApplyDream(sim);
+					break;
+				case ACTION_START_TURN:
+					NextTurn(sim);
+					break;
+				case ACTION_START_GAME:
+					sim->cutscene = false;
+					sim->active = true;
+					sim->started = true;
+					break;
+				case ACTION_SLEEP:
+					Sleep(sim);
+					break;
+			}
+		} else if (sim->active) {
+			Move(sim);
+		} else {
+			break; // nothing queued and nobody to move; the game would hang here
+		}
+	}
+}
+
+static void Record(struct Sim* sim, struct Stats* stats) {
+	stats->games++;
+	stats->moves += sim->moves;
+	for (int g = 0; g < 2; g++) {
+		for (int i = 0; i < 6; i++) {
+			stats->dreams[g][i] += sim->dreams[g][i];
+		}
+	}
+	if (!sim->ended) {
+		stats->stuck++;
+		return;
+	}
+	stats->rounds[sim->rounds < MAX_ROUNDS ? sim->rounds : MAX_ROUNDS]++;
+
+	// the game doesn't name a winner; take whoever got the farthest
+	int best = 0, count = 0;
+	for (int i = 0; i < sim->playerCount; i++) {
+		if (sim->players[i].position > sim->players[best].position) {
+			best = i;
+			count = 1;
+		} else if (sim->players[i].position == sim->players[best].position) {
+			count++;
+		}
+	}
+	if (count > 1) {
+		stats->ties++;
+	} else {
+		stats->wins[best]++;
+	}
+}
+
+static void* Work(void* arg) {
+	struct Worker* worker = arg;
+	struct Sim sim = {.policy = worker->policy, .playerCount = worker->players};
+	for (uint64_t i = 0; i < worker->count; i++) {
+		Play(&sim, worker->seed + worker->first + i);
+		Record(&sim, &worker->stats);
+	}
+	return NULL;
+}
+
+static void Merge(struct Stats* total, struct Stats* stats) {
+	total->games += stats->games;
+	total->stuck += stats->stuck;
+	total->ties += stats->ties;
+	total->moves += stats->moves;
+	for (int i = 0; i < MAX_PLAYERS; i++) {
+		total->wins[i] += stats->wins[i];
+	}
+	for (int i = 0; i <= MAX_ROUNDS; i++) {
+		total->rounds[i] += stats->rounds[i];
+	}
+	for (int g = 0; g < 2; g++) {
+		for (int i = 0; i < 6; i++) {
+			total->dreams[g][i] += stats->dreams[g][i];
+		}
+	}
+}
+
+static int Percentile(struct Stats* stats, double p) {
+	uint64_t finished = stats->games - stats->stuck, seen = 0;
+	for (int i = 0; i <= MAX_ROUNDS; i++) {
+		seen += stats->rounds[i];
+		if (seen > 0 && seen >= p * finished) {
+			return i;
+		}
+	}
+	return MAX_ROUNDS;
+}
+
+static void Report(struct Stats* stats, int players, double elapsed) {
+	uint64_t finished = stats->games - stats->stuck;
+	printf("balance: %" PRIu64 " games in %.3f s (%.0f games/s)\n", stats->games, elapsed, stats->games / elapsed);
+	printf("finished: %" PRIu64 ", stuck: %" PRIu64 ", moves per game: %.2f\n", finished, stats->stuck, (double)stats->moves / stats->games);
+
+	double mean = 0;
+	int min = -1, max = 0;
+	for (int i = 0; i <= MAX_ROUNDS; i++) {
+		if (stats->rounds[i]) {
+			mean += (double)i * stats->rounds[i];
+			if (min < 0) {
+				min = i;
+			}
+			max = i;
+		}
+	}
+	if (finished) {
+		mean /= finished;
+	}
+	printf("\ngame length in rounds: mean %.2f, min %d, p10 %d, p50 %d, p90 %d, p99 %d, max %d\n", mean, min, Percentile(stats, 0.1), Percentile(stats, 0.5), Percentile(stats, 0.9), Percentile(stats, 0.99), max);
+	for (int i = 0; i < MAX_ROUNDS; i += 10) {
+		uint64_t count = 0;
+		for (int j = i; j < i + 10 && j < MAX_ROUNDS; j++) {
+			count += stats->rounds[j];
+		}
+		if (count) {
+			printf("  %3d-%-3d %6.2f%%\n", i, i + 9 < MAX_ROUNDS ? i + 9 : MAX_ROUNDS - 1, 100.0 * count / finished);
+		}
+	}
+	if (stats->rounds[MAX_ROUNDS]) {
+		printf("  %3d     %6.2f%%\n", MAX_ROUNDS, 100.0 * stats->rounds[MAX_ROUNDS] / finished);
+	}
+
+	printf("\nwin rate by seat:\n");
+	for (int i = 0; i < players; i++) {
+		printf("  player %d %6.2f%%\n", i + 1, finished ? 100.0 * stats->wins[i] / finished : 0.0);
+	}
+	printf("  tie      %6.2f%%\n", finished ? 100.0 * stats->ties / finished : 0.0);
+
+	printf("\ndream triggers per game:\n");
+	for (int g = 1; g >= 0; g--) {
+		for (int i = 1; i < 6; i++) {
+			if (stats->dreams[g][i]) {
+				printf("  %s %d %8.4f\n", g ? "good" : "bad ", i, (double)stats->dreams[g][i] / stats->games);
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	uint64_t games = 1000000, seed = time(NULL);
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int players = 4;
+	enum Policy policy = POLICY_RANDOM;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "g:t:p:s:m:")) != -1) {
+		switch (opt) {
+			case 'g':
+				games = strtoull(optarg, NULL, 10);
+				break;
+			case 't':
+				threads = strtol(optarg, NULL, 10);
+				break;
+			case 'p':
+				players = strtol(optarg, NULL, 10);
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'm':
+				policy = strcmp(optarg, "1") == 0 ? POLICY_ONE : strcmp(optarg, "2") == 0 ? POLICY_TWO : POLICY_RANDOM;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-g games] [-t threads] [-p players] [-s seed] [-m 1|2|random]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (players < 1 || players > MAX_PLAYERS) {
+		fprintf(stderr, "balance: player count has to be between 1 and %d\n", MAX_PLAYERS);
+		return 1;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	printf("balance: seed %" PRIu64 ", %d players, %ld threads\n", seed, players, threads);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	struct Worker* workers = calloc(threads, sizeof(struct Worker));
+	uint64_t first = 0;
+	for (long i = 0; i < threads; i++) {
+		workers[i].seed = seed;
+		workers[i].first = first;
+		workers[i].count = games / threads + ((uint64_t)i < games % threads ? 1 : 0);
+		workers[i].policy = policy;
+		workers[i].players = players;
+		first += workers[i].count;
+		if (pthread_create(&workers[i].thread, NULL, Work, &workers[i])) {
+			fprintf(stderr, "balance: could not start thread %ld\n", i);
+			return 1;
+		}
+	}
+	struct Stats* total = calloc(1, sizeof(struct Stats));
+	for (long i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		Merge(total, &workers[i].stats);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	Report(total, players, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	free(total);
+	free(workers);
+	return 0;
+}
@@ -0,0 +1,226 @@
+/*! \file pack.c
+ *  \brief Build-time packer producing data.pack.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: pack <output> <data dir> [<prefix>=<dir>]...
+//
+// Collects every file under the data directory, plus the files of any further
+// directories (placed under the given prefix, so generated atlases can be added as
+// sprites=<build dir>/sprites), and writes them into a single pack with a
+// sorted index. Later directories override earlier ones. See src/pack.h for the
+// layout; the game maps the result and loads assets straight out of it.
+
+#include <allegro5/allegro.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACK_MAGIC "WWPACK1"
+#define PACK_HEADER_SIZE 16
+#define PACK_ENTRY_SIZE 24
+#define PACK_ALIGNMENT 16
+
+// same as the install rule in data/CMakeLists.txt, plus the pack itself and in-source build leftovers
+static const char* skipped[] = {"stuff", ".git", ".gitignore", ".directory", "CMakeLists.txt", "data.pack",
+	"CMakeFiles", "Makefile", "cmake_install.cmake"};
+
+struct File {
+	char* name; // relative, with forward slashes
+	char* path;
+	uint64_t size, offset, nameOffset;
+};
+
+static struct File* files = NULL;
+static int fileCount = 0, fileCapacity = 0;
+
+static void AddFile(const char* name, const char* path, uint64_t size) {
+	for (int i = 0; i < fileCount; i++) {
+		if (strcmp(files[i].name, name) == 0) {
+			free(files[i].path);
+			files[i].path = strdup(path);
+			files[i].size = size;
+			return;
+		}
+	}
+	if (fileCount == fileCapacity) {
+		fileCapacity = fileCapacity ? fileCapacity * 2 : 256;
+		files = realloc(files, sizeof(struct File) * fileCapacity);
+	}
+	files[fileCount++] = (struct File){.name = strdup(name), .path = strdup(path), .size = size};
+}
+
+static const char* GetBaseName(const char* path) {
+	const char* base = path;
+	for (const char* c = path; *c; c++) {
+		if ((*c == '/' || *c == '\\') && c[1]) {
+			base = c + 1;
+		}
+	}
+	return base;
+}
+
+static bool Scan(const char* dirname, const char* prefix) {
+	ALLEGRO_FS_ENTRY* dir = al_create_fs_entry(dirname);
+	if (!al_open_directory(dir)) {
+		fprintf(stderr, "pack: could not open %s\n", dirname);
+		al_destroy_fs_entry(dir);
+		return false;
+	}
+	bool ok = true;
+	ALLEGRO_FS_ENTRY* entry;
+	while (ok && (entry = al_read_directory(dir))) {
+		const char* path = al_get_fs_entry_name(entry);
+		char base[256];
+		snprintf(base, sizeof(base), "%s", GetBaseName(path));
+		size_t len = strlen(base);
+		if (len && (base[len - 1] == '/' || base[len - 1] == '\\')) {
+			base[len - 1] = 0;
+		}
+		bool skip = false;
+		for (size_t i = 0; i < sizeof(skipped) / sizeof(skipped[0]); i++) {
+			if (strcmp(base, skipped[i]) == 0) {
+				skip = true;
+			}
+		}
+		if (!skip) {
+			char name[1024];
+			snprintf(name, sizeof(name), "%s%s%s", prefix, prefix[0] ? "/" : "", base);
+			if (al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR) {
+				ok = Scan(path, name);
+			} else {
+				AddFile(name, path, al_get_fs_entry_size(entry));
+			}
+		}
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+	al_destroy_fs_entry(dir);
+	return ok;
+}
+
+static int CompareName(const void* a, const void* b) {
+	return strcmp(((const struct File*)a)->name, ((const struct File*)b)->name);
+}
+
+static void WriteU64(unsigned char* p, uint64_t value) {
+	for (int i = 0; i < 8; i++) {
+		p[i] = value >> (i * 8);
+	}
+}
+
+static bool CopyFile(FILE* out, struct File* file) {
+	ALLEGRO_FILE* in = al_fopen(file->path, "rb");
+	if (!in) {
+		fprintf(stderr, "pack: could not read %s\n", file->path);
+		return false;
+	}
+	char buffer[65536];
+	uint64_t left = file->size;
+	while (left) {
+		size_t n = al_fread(in, buffer, left < sizeof(buffer) ? left : sizeof(buffer));
+		if (!n || fwrite(buffer, 1, n, out) != n) {
+			fprintf(stderr, "pack: could not copy %s\n", file->path);
+			al_fclose(in);
+			return false;
+		}
+		left -= n;
+	}
+	al_fclose(in);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <output> <data dir> [<prefix>=<dir>]...\n", argv[0]);
+		return 1;
+	}
+	if (!al_init()) {
+		fprintf(stderr, "pack: could not initialize Allegro\n");
+		return 1;
+	}
+
+	for (int i = 2; i < argc; i++) {
+		char* dir = strchr(argv[i], '=');
+		if (dir) {
+			*dir++ = 0;
+		}
+		if (!Scan(dir ? dir : argv[i], dir ? argv[i] : "")) {
+			return 1;
+		}
+	}
+	qsort(files, fileCount, sizeof(struct File), CompareName);
+
+	// names right after the index, then the data
+	uint64_t offset = PACK_HEADER_SIZE + (uint64_t)fileCount * PACK_ENTRY_SIZE;
+	for (int i = 0; i < fileCount; i++) {
+		files[i].nameOffset = offset;
+		offset += strlen(files[i].name) + 1;
+	}
+	for (int i = 0; i < fileCount; i++) {
+		offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+		files[i].offset = offset;
+		offset += files[i].size;
+	}
+
+	FILE* out = fopen(argv[1], "wb");
+	if (!out) {
+		fprintf(stderr, "pack: could not write %s\n", argv[1]);
+		return 1;
+	}
+	unsigned char header[PACK_HEADER_SIZE] = {0};
+	memcpy(header, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header[8] = fileCount;
+	header[9] = fileCount >> 8;
+	header[10] = fileCount >> 16;
+	header[11] = fileCount >> 24;
+	fwrite(header, 1, PACK_HEADER_SIZE, out);
+	for (int i = 0; i < fileCount; i++) {
+		unsigned char entry[PACK_ENTRY_SIZE];
+		WriteU64(entry, files[i].nameOffset);
+		WriteU64(entry + 8, files[i].offset);
+		WriteU64(entry + 16, files[i].size);
+		fwrite(entry, 1, PACK_ENTRY_SIZE, out);
+	}
+	for (int i = 0; i < fileCount; i++) {
+		fwrite(files[i].name, 1, strlen(files[i].name) + 1, out);
+	}
+	bool ok = true;
+	for (int i = 0; ok && i < fileCount; i++) {
+		static const char padding[PACK_ALIGNMENT] = {0};
+		fwrite(padding, 1, files[i].offset - ftell(out), out);
+		ok = CopyFile(out, &files[i]);
+	}
+	if (fclose(out) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		remove(argv[1]);
+		return 1;
+	}
+
+	printf("pack: %d files, %llu bytes written to %s\n", fileCount, (unsigned long long)offset, argv[1]);
+
+	for (int i = 0; i < fileCount; i++) {
+		free(files[i].name);
+		free(files[i].path);
+	}
+	free(files);
+	return 0;
+}
@@ -0,0 +1,301 @@
+/*! \file spritec.c
+ *  \brief Build-time compiler of spritesheet INIs into a binary manifest.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: spritec <sprites dir> <output>
+//
+// Parses the spritesheet INIs of every character directory and writes a single
+// manifest with frame tables, effective frame durations, pivots and successors
+// resolved to indices (see src/sprites.h for the layout). Spritesheets using keys
+// that aren't understood here are left out with a warning, so the game keeps reading
+// those from their INIs. A successor that doesn't exist is an error.
+
+#include <allegro5/allegro.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPRITES_MAGIC "WWSPR1"
+#define SPRITES_HEADER_SIZE 24
+#define SPRITES_FLAG_BIDIR 1
+
+// what RegisterSpritesheet falls back to for missing keys; the game checks the result
+// against the engine in debug mode (CheckManifest in src/sprites.c)
+#define DEFAULT_DURATION 16.66
+#define DEFAULT_PIVOT 0.5
+
+struct Frame {
+	char* file;
+	float duration;
+};
+
+struct Sheet {
+	char* character;
+	char* name;
+	struct Frame* frames;
+	int frameCount;
+	float duration, pivotX, pivotY;
+	char* successor;
+	int successorIndex;
+	bool bidir;
+};
+
+static struct Sheet* sheets = NULL;
+static int sheetCount = 0, sheetCapacity = 0;
+
+static char* strings = NULL;
+static size_t stringsSize = 0, stringsCapacity = 0;
+
+static uint32_t AddString(const char* s) {
+	// identical strings (like frame files shared between spritesheets) are stored once
+	for (size_t i = 0; i < stringsSize; i += strlen(strings + i) + 1) {
+		if (strcmp(strings + i, s) == 0) {
+			return i;
+		}
+	}
+	size_t len = strlen(s) + 1;
+	while (stringsSize + len > stringsCapacity) {
+		stringsCapacity = stringsCapacity ? stringsCapacity * 2 : 4096;
+		strings = realloc(strings, stringsCapacity);
+	}
+	memcpy(strings + stringsSize, s, len);
+	stringsSize += len;
+	return stringsSize - len;
+}
+
+static bool IsKnown(const char* section, const char* key) {
+	if (strcmp(section, "animation") == 0) {
+		return !strcmp(key, "duration") || !strcmp(key, "frames") || !strcmp(key, "successor") || !strcmp(key, "bidir");
+	}
+	if (strcmp(section, "pivot") == 0) {
+		return !strcmp(key, "x") || !strcmp(key, "y");
+	}
+	if (strncmp(section, "frame", 5) == 0) {
+		return !strcmp(key, "file") || !strcmp(key, "duration");
+	}
+	return false;
+}
+
+static double GetDouble(ALLEGRO_CONFIG* config, const char* section, const char* key, double def) {
+	const char* value = al_get_config_value(config, section, key);
+	return value ? strtod(value, NULL) : def;
+}
+
+static bool ReadSheet(const char* path, const char* character, const char* name) {
+	ALLEGRO_CONFIG* config = al_load_config_file(path);
+	if (!config) {
+		fprintf(stderr, "spritec: could not read %s\n", path);
+		return false;
+	}
+	ALLEGRO_CONFIG_SECTION* si;
+	ALLEGRO_CONFIG_ENTRY* ei;
+	for (const char* section = al_get_first_config_section(config, &si); section; section = al_get_next_config_section(&si)) {
+		for (const char* key = al_get_first_config_entry(config, section, &ei); key; key = al_get_next_config_entry(&ei)) {
+			if (!IsKnown(section, key)) {
+				fprintf(stderr, "spritec: warning: %s: [%s] %s isn't supported, leaving it to the engine\n", path, section, key);
+				al_destroy_config(config);
+				return true;
+			}
+		}
+	}
+
+	struct Sheet sheet = {.character = strdup(character), .name = strdup(name), .successorIndex = -1};
+	const char* frames = al_get_config_value(config, "animation", "frames");
+	sheet.frameCount = frames ? strtol(frames, NULL, 10) : 1;
+	sheet.duration = GetDouble(config, "animation", "duration", DEFAULT_DURATION);
+	sheet.bidir = GetDouble(config, "animation", "bidir", 0);
+	sheet.pivotX = GetDouble(config, "pivot", "x", DEFAULT_PIVOT);
+	sheet.pivotY = GetDouble(config, "pivot", "y", DEFAULT_PIVOT);
+	const char* successor = al_get_config_value(config, "animation", "successor");
+	sheet.successor = successor ? strdup(successor) : NULL;
+	sheet.frames = calloc(sheet.frameCount, sizeof(struct Frame));
+	for (int i = 0; i < sheet.frameCount; i++) {
+		char section[32];
+		snprintf(section, 32, "frame%d", i);
+		const char* file = al_get_config_value(config, section, "file");
+		if (!file) {
+			// a single image spritesheet; those are loaded differently and stay with the engine
+			fprintf(stderr, "spritec: warning: %s: [%s] has no file, leaving it to the engine\n", path, section);
+			al_destroy_config(config);
+			return true;
+		}
+		sheet.frames[i].file = strdup(file);
+		sheet.frames[i].duration = GetDouble(config, section, "duration", sheet.duration);
+	}
+	al_destroy_config(config);
+
+	if (sheetCount == sheetCapacity) {
+		sheetCapacity = sheetCapacity ? sheetCapacity * 2 : 64;
+		sheets = realloc(sheets, sizeof(struct Sheet) * sheetCapacity);
+	}
+	sheets[sheetCount++] = sheet;
+	return true;
+}
+
+static bool ReadCharacter(ALLEGRO_FS_ENTRY* dir, const char* character) {
+	if (!al_open_directory(dir)) {
+		return false;
+	}
+	bool ok = true;
+	ALLEGRO_FS_ENTRY* entry;
+	while (ok && (entry = al_read_directory(dir))) {
+		ALLEGRO_PATH* path = al_create_path(al_get_fs_entry_name(entry));
+		if (strcmp(al_get_path_extension(path), ".ini") == 0 && strcmp(al_get_path_filename(path), "atlas.ini") != 0) {
+			ok = ReadSheet(al_get_fs_entry_name(entry), character, al_get_path_basename(path));
+		}
+		al_destroy_path(path);
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+	return ok;
+}
+
+static int CompareSheets(const void* a, const void* b) {
+	const struct Sheet* s1 = a;
+	const struct Sheet* s2 = b;
+	int c = strcmp(s1->character, s2->character);
+	return c ? c : strcmp(s1->name, s2->name);
+}
+
+static void PutU32(FILE* file, uint32_t value) {
+	unsigned char p[4] = {value, value >> 8, value >> 16, value >> 24};
+	fwrite(p, 1, 4, file);
+}
+
+static void PutFloat(FILE* file, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+	PutU32(file, bits);
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <sprites dir> <output>\n", argv[0]);
+		return 1;
+	}
+	if (!al_init()) {
+		fprintf(stderr, "spritec: could not initialize Allegro\n");
+		return 1;
+	}
+
+	ALLEGRO_FS_ENTRY* root = al_create_fs_entry(argv[1]);
+	if (!al_open_directory(root)) {
+		fprintf(stderr, "spritec: could not open %s\n", argv[1]);
+		return 1;
+	}
+	ALLEGRO_FS_ENTRY* entry;
+	while ((entry = al_read_directory(root))) {
+		if (al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR) {
+			ALLEGRO_PATH* path = al_create_path_for_directory(al_get_fs_entry_name(entry));
+			const char* character = al_get_path_component(path, -1);
+			if (!ReadCharacter(entry, character)) {
+				fprintf(stderr, "spritec: could not read %s\n", al_get_fs_entry_name(entry));
+				return 1;
+			}
+			al_destroy_path(path);
+		}
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(root);
+	al_destroy_fs_entry(root);
+
+	qsort(sheets, sheetCount, sizeof(struct Sheet), CompareSheets);
+
+	// successors are looked up within the same character
+	for (int i = 0; i < sheetCount; i++) {
+		if (!sheets[i].successor) {
+			continue;
+		}
+		for (int j = 0; j < sheetCount; j++) {
+			if (!strcmp(sheets[j].character, sheets[i].character) && !strcmp(sheets[j].name, sheets[i].successor)) {
+				sheets[i].successorIndex = j;
+			}
+		}
+		if (sheets[i].successorIndex < 0) {
+			fprintf(stderr, "spritec: %s/%s: successor %s doesn't exist\n", sheets[i].character, sheets[i].name, sheets[i].successor);
+			return 1;
+		}
+	}
+
+	int characterCount = 0, frameCount = 0;
+	for (int i = 0; i < sheetCount; i++) {
+		if (!i || strcmp(sheets[i].character, sheets[i - 1].character)) {
+			characterCount++;
+		}
+		frameCount += sheets[i].frameCount;
+	}
+	// strings get collected up front, as their table size goes into the header
+	for (int i = 0; i < sheetCount; i++) {
+		AddString(sheets[i].character);
+		AddString(sheets[i].name);
+		for (int f = 0; f < sheets[i].frameCount; f++) {
+			AddString(sheets[i].frames[f].file);
+		}
+	}
+
+	FILE* file = fopen(argv[2], "wb");
+	if (!file) {
+		fprintf(stderr, "spritec: could not write %s\n", argv[2]);
+		return 1;
+	}
+	char magic[8] = SPRITES_MAGIC;
+	fwrite(magic, 1, 8, file);
+	PutU32(file, characterCount);
+	PutU32(file, sheetCount);
+	PutU32(file, frameCount);
+	PutU32(file, stringsSize);
+
+	for (int i = 0; i < sheetCount;) {
+		int first = i;
+		while (i < sheetCount && !strcmp(sheets[i].character, sheets[first].character)) {
+			i++;
+		}
+		PutU32(file, AddString(sheets[first].character));
+		PutU32(file, first);
+		PutU32(file, i - first);
+	}
+	int frame = 0;
+	for (int i = 0; i < sheetCount; i++) {
+		PutU32(file, AddString(sheets[i].name));
+		PutU32(file, frame);
+		PutU32(file, sheets[i].frameCount);
+		PutFloat(file, sheets[i].duration);
+		PutFloat(file, sheets[i].pivotX);
+		PutFloat(file, sheets[i].pivotY);
+		PutU32(file, (uint32_t)sheets[i].successorIndex);
+		PutU32(file, sheets[i].bidir ? SPRITES_FLAG_BIDIR : 0);
+		frame += sheets[i].frameCount;
+	}
+	for (int i = 0; i < sheetCount; i++) {
+		for (int f = 0; f < sheets[i].frameCount; f++) {
+			PutU32(file, AddString(sheets[i].frames[f].file));
+			PutFloat(file, sheets[i].frames[f].duration);
+		}
+	}
+	fwrite(strings, 1, stringsSize, file);
+	if (fclose(file) != 0) {
+		fprintf(stderr, "spritec: could not write %s\n", argv[2]);
+		remove(argv[2]);
+		return 1;
+	}
+
+	printf("spritec: %d spritesheets of %d characters (%d frames) written to %s\n", sheetCount, characterCount, frameCount, argv[2]);
+	return 0;
+}
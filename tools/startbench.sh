@@ -0,0 +1,42 @@
+#!/bin/sh
+# Usage: tools/startbench.sh <game binary> [runs]
+#
+# Compares time-to-first-frame of the board between pre-decoded textures
+# (see tools/texconv.c) and decoding the original images, by running the game
+# with --bench-startup a few times each way and printing the median.
+# Run it from wherever the game finds its data (for example the install prefix),
+# with the build's .tex files in place.
+
+set -e
+
+if [ -z "$1" ]; then
+	echo "usage: $0 <game binary> [runs]" >&2
+	exit 1
+fi
+GAME=$1
+RUNS=${2:-5}
+
+median() {
+	sort -n | awk '{ v[NR] = $1 } END { if (NR % 2) print v[(NR + 1) / 2]; else print (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+for mode in textures images; do
+	if [ "$mode" = images ]; then
+		FLAGS=--no-textures
+	else
+		FLAGS=
+	fi
+	times=""
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		t=$("$GAME" --bench-startup $FLAGS 2>/dev/null | sed -n 's/^startup: first frame after \([0-9.]*\) s.*/\1/p')
+		if [ -z "$t" ]; then
+			echo "$mode: run $i didn't report a frame" >&2
+			exit 1
+		fi
+		times="$times$t
+"
+		i=$((i + 1))
+	done
+	printf '%-8s median %s s over %d runs\n' "$mode" "$(printf '%s' "$times" | median)" "$RUNS"
+done
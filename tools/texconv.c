@@ -0,0 +1,171 @@
+/*! \file texconv.c
+ *  \brief Build-time converter from images to pre-decoded textures.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: texconv <input dir> <output dir>
+//
+// Decodes every PNG, WebP and JPEG image in the input directory (not recursively)
+// and writes its premultiplied pixels as <name>.tex into the output directory,
+// run-length encoded when that turns out smaller. See src/texture.h for the format.
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEX_MAGIC "WWTEX1"
+#define TEX_HEADER_SIZE 24
+#define TEX_ENCODING_RAW 0
+#define TEX_ENCODING_RLE 1
+
+static const char* extensions[] = {".png", ".webp", ".jpg"};
+
+static void PutU32(unsigned char* p, uint32_t value) {
+	p[0] = value;
+	p[1] = value >> 8;
+	p[2] = value >> 16;
+	p[3] = value >> 24;
+}
+
+static size_t Encode(const uint32_t* pixels, size_t count, unsigned char* out) {
+	// runs of at least 3 equal pixels are worth a token of their own
+	size_t size = 0, literal = 0;
+	for (size_t i = 0; i <= count; i++) {
+		size_t run = 1;
+		while (i < count && i + run < count && pixels[i + run] == pixels[i] && run < 0x7fffffff) {
+			run++;
+		}
+		if (i == count || run >= 3) {
+			if (literal) {
+				PutU32(out + size, literal);
+				memcpy(out + size + 4, pixels + i - literal, literal * 4);
+				size += 4 + literal * 4;
+				literal = 0;
+			}
+			if (i == count) {
+				break;
+			}
+			PutU32(out + size, run | 0x80000000u);
+			memcpy(out + size + 4, pixels + i, 4);
+			size += 8;
+			i += run - 1;
+		} else {
+			literal++;
+		}
+	}
+	return size;
+}
+
+static bool Convert(const char* input, const char* output) {
+	ALLEGRO_BITMAP* bitmap = al_load_bitmap(input);
+	if (!bitmap) {
+		fprintf(stderr, "texconv: could not load %s\n", input);
+		return false;
+	}
+	int w = al_get_bitmap_width(bitmap), h = al_get_bitmap_height(bitmap);
+	size_t count = (size_t)w * h;
+	uint32_t* pixels = malloc(count * 4);
+	ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	for (int y = 0; y < h; y++) {
+		memcpy(pixels + (size_t)y * w, (char*)region->data + y * region->pitch, w * 4);
+	}
+	al_unlock_bitmap(bitmap);
+	al_destroy_bitmap(bitmap);
+
+	// worst case for RLE is one token per pixel pair, which is still less than twice the raw size
+	unsigned char* rle = malloc(count * 8 + 8);
+	size_t size = Encode(pixels, count, rle);
+	int encoding = size < count * 4 ? TEX_ENCODING_RLE : TEX_ENCODING_RAW;
+	if (encoding == TEX_ENCODING_RAW) {
+		size = count * 4;
+	}
+
+	unsigned char header[TEX_HEADER_SIZE] = {0};
+	memcpy(header, TEX_MAGIC, sizeof(TEX_MAGIC));
+	PutU32(header + 8, w);
+	PutU32(header + 12, h);
+	PutU32(header + 16, encoding);
+	PutU32(header + 20, size);
+
+	FILE* file = fopen(output, "wb");
+	bool ok = file && fwrite(header, 1, TEX_HEADER_SIZE, file) == TEX_HEADER_SIZE &&
+		fwrite(encoding == TEX_ENCODING_RLE ? (void*)rle : (void*)pixels, 1, size, file) == size;
+	if (file && fclose(file) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		fprintf(stderr, "texconv: could not write %s\n", output);
+		remove(output);
+	} else {
+		printf("texconv: %s -> %s (%dx%d, %s, %zu bytes)\n", input, output, w, h, encoding == TEX_ENCODING_RLE ? "rle" : "raw", size);
+	}
+	free(rle);
+	free(pixels);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		fprintf(stderr, "usage: %s <input dir> <output dir>\n", argv[0]);
+		return 1;
+	}
+	if (!al_init() || !al_init_image_addon()) {
+		fprintf(stderr, "texconv: could not initialize Allegro\n");
+		return 1;
+	}
+	// Allegro premultiplies while decoding; that's what the game expects to find in the .tex
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	ALLEGRO_FS_ENTRY* dir = al_create_fs_entry(argv[1]);
+	if (!al_open_directory(dir)) {
+		fprintf(stderr, "texconv: could not open %s\n", argv[1]);
+		return 1;
+	}
+	al_make_directory(argv[2]);
+
+	bool ok = true;
+	int converted = 0;
+	ALLEGRO_FS_ENTRY* entry;
+	while (ok && (entry = al_read_directory(dir))) {
+		ALLEGRO_PATH* path = al_create_path(al_get_fs_entry_name(entry));
+		bool image = false;
+		for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+			if (strcmp(al_get_path_extension(path), extensions[i]) == 0) {
+				image = true;
+			}
+		}
+		if (image && !(al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR)) {
+			ALLEGRO_PATH* out = al_create_path_for_directory(argv[2]);
+			al_set_path_filename(out, al_get_path_filename(path));
+			al_set_path_extension(out, ".tex");
+			ok = Convert(al_get_fs_entry_name(entry), al_path_cstr(out, ALLEGRO_NATIVE_PATH_SEP));
+			converted++;
+			al_destroy_path(out);
+		}
+		al_destroy_path(path);
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+	al_destroy_fs_entry(dir);
+
+	printf("texconv: %d image(s) from %s converted\n", converted, argv[1]);
+	return ok ? 0 : 1;
+}
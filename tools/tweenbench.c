@@ -0,0 +1,132 @@
+/*! \file tweenbench.c
+ *  \brief Compares the engine tweens with TweenBatch.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Usage: tweenbench [tweens] [frames]
+//
+// Runs the same set of dream-like tweens (elastic and sine, restarted as soon
+// as they finish) through an array of engine Tweens and through a TweenBatch,
+// with and without lookup tables, and prints the time per tween update. It
+// also prints the largest difference between each batch kernel and the
+// engine's Interpolate, so the lookup table size can be judged.
+
+#include "../src/common.h"
+#include <libsuperderpy.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DELTA (1 / 60.0)
+
+static const enum TWEEN_STYLE styles[] = {TWEEN_STYLE_LINEAR, TWEEN_STYLE_QUARTIC_IN_OUT, TWEEN_STYLE_QUINTIC_OUT,
+	TWEEN_STYLE_BACK_IN_OUT, TWEEN_STYLE_ELASTIC_OUT, TWEEN_STYLE_SINE_IN_OUT};
+static const char* names[] = {"linear", "quartic in-out", "quintic out", "back in-out", "elastic out", "sine in-out"};
+
+static double Now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static enum TWEEN_STYLE PickStyle(int i) {
+	return i % 2 ? TWEEN_STYLE_ELASTIC_OUT : TWEEN_STYLE_SINE_IN_OUT;
+}
+
+static double BenchScalar(int count, int frames) {
+	struct Tween* tweens = calloc(count, sizeof(struct Tween));
+	for (int i = 0; i < count; i++) {
+		tweens[i] = Tween(NULL, 0.0, 1.0, PickStyle(i), 1.0 + i % 3);
+	}
+	volatile double sink = 0;
+	double start = Now();
+	for (int f = 0; f < frames; f++) {
+		for (int i = 0; i < count; i++) {
+			UpdateTween(&tweens[i], DELTA);
+			sink += GetTweenValue(&tweens[i]);
+			if (GetTweenPosition(&tweens[i]) >= 1.0) {
+				tweens[i] = Tween(NULL, 0.0, 1.0, PickStyle(i), 1.0 + i % 3);
+			}
+		}
+	}
+	double time = Now() - start;
+	free(tweens);
+	return time;
+}
+
+static double BenchBatch(int count, int frames, bool lut) {
+	struct TweenBatch* batch = CreateTweenBatch(count, lut);
+	for (int i = 0; i < count; i++) {
+		SetTween(batch, i, 0.0, 1.0, PickStyle(i), 1.0 + i % 3);
+	}
+	volatile double sink = 0;
+	double start = Now();
+	for (int f = 0; f < frames; f++) {
+		UpdateTweens(batch, DELTA);
+		for (int i = 0; i < count; i++) {
+			sink += GetBatchTweenValue(batch, i);
+			if (GetBatchTweenPosition(batch, i) >= 1.0) {
+				SetTween(batch, i, 0.0, 1.0, PickStyle(i), 1.0 + i % 3);
+			}
+		}
+	}
+	double time = Now() - start;
+	DestroyTweenBatch(batch);
+	return time;
+}
+
+static double MaxError(enum TWEEN_STYLE style, bool lut) {
+	// steps through a single tween in small, uneven increments, so values between the table samples get checked too
+	struct TweenBatch* batch = CreateTweenBatch(1, lut);
+	SetTween(batch, 0, 0.0, 1.0, style, 1.0);
+	double error = 0;
+	while (GetBatchTweenPosition(batch, 0) < 1.0) {
+		UpdateTweens(batch, 0.000937);
+		double diff = fabs(GetBatchTweenValue(batch, 0) - Interpolate(GetBatchTweenPosition(batch, 0), style));
+		if (diff > error) {
+			error = diff;
+		}
+	}
+	DestroyTweenBatch(batch);
+	return error;
+}
+
+int main(int argc, char** argv) {
+	int counts[] = {argc > 1 ? strtol(argv[1], NULL, 10) : 96, 1024, 16384};
+	int frames = argc > 2 ? strtol(argv[2], NULL, 10) : 6000;
+
+	printf("%-8s %12s %12s %12s  (ns per tween update)\n", "tweens", "engine", "batch", "batch+lut");
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		int count = counts[c];
+		// keep the total amount of work roughly the same for every count
+		int n = frames * counts[0] / count;
+		if (n < 1) {
+			n = 1;
+		}
+		double updates = (double)count * n;
+		printf("%-8d %12.2f %12.2f %12.2f\n", count, BenchScalar(count, n) / updates * 1e9,
+			BenchBatch(count, n, false) / updates * 1e9, BenchBatch(count, n, true) / updates * 1e9);
+	}
+
+	printf("\n%-16s %12s %12s  (max error against Interpolate)\n", "style", "batch", "batch+lut");
+	for (size_t s = 0; s < sizeof(styles) / sizeof(styles[0]); s++) {
+		printf("%-16s %12.2e %12.2e\n", names[s], MaxError(styles[s], false), MaxError(styles[s], true));
+	}
+	return 0;
+}